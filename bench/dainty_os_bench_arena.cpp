@@ -0,0 +1,125 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+// per request allocation churn on the thread's t_arena, with and without a
+// t_arena_slab on top, against malloc and free, as the thread count grows.
+// a request allocates REQUEST_OBJS objects of mixed sizes, writes to them
+// and releases them again.
+//
+// build from the top directory, with dainty_named and dainty_oops on the
+// include path:
+//   g++ -std=c++17 -O2 -I. bench/dainty_os_bench_arena.cpp dainty_os_*.cpp
+//       -pthread
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "dainty_os_clock.h"
+#include "dainty_os_threading.h"
+
+using namespace dainty::named;
+using namespace dainty::os;
+using namespace dainty::os::threading;
+using dainty::os::clock::t_time;
+
+namespace
+{
+  constexpr t_n_ THREADS_MAX  = 8;
+  constexpr long REQUESTS     = 20000;
+  constexpr t_n_ REQUEST_OBJS = 64;
+  constexpr t_n_ ARENA_SIZE   = 1 << 20;
+
+  enum t_kind { MALLOC, ARENA, SLAB };
+
+  // sizes from 16 to 527 bytes, the same sequence for every kind
+  t_n_ next_size_(t_uint32& seed) noexcept {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return 16 + seed % 512;
+  }
+
+  p_void run_(p_void arg) {
+    auto     kind  = *static_cast<t_kind*>(arg);
+    auto     arena = t_arena::get_thread();
+    t_uint32 seed  = 2463534242u;
+    p_void   objs[REQUEST_OBJS];
+    t_n_     sizes[REQUEST_OBJS];
+    t_arena_slab slab{*arena};
+    for (long request = 0; request < REQUESTS; ++request) {
+      for (t_n_ ix = 0; ix < REQUEST_OBJS; ++ix) {
+        sizes[ix] = next_size_(seed);
+        switch (kind) {
+          case MALLOC: objs[ix] = std::malloc(sizes[ix]);              break;
+          case ARENA:  objs[ix] = arena->allocate(t_n{sizes[ix]});     break;
+          case SLAB:   objs[ix] = slab.allocate(t_n{sizes[ix]});       break;
+        }
+        std::memset(objs[ix], int(ix), sizes[ix]);
+      }
+      switch (kind) {
+        case MALLOC:
+          for (t_n_ ix = 0; ix < REQUEST_OBJS; ++ix)
+            std::free(objs[ix]);
+          break;
+        case ARENA:
+          arena->reset();
+          break;
+        case SLAB:
+          for (t_n_ ix = 0; ix < REQUEST_OBJS; ++ix)
+            slab.deallocate(objs[ix], t_n{sizes[ix]});
+          break;
+      }
+    }
+    return nullptr;
+  }
+
+  t_int64 elapsed_nsec_(t_time start) noexcept {
+    auto time = clock::monotonic_now();
+    time -= start;
+    return get(time.to<t_nsec>());
+  }
+
+  t_void bench_(const char* name, t_kind kind, t_n_ threads) noexcept {
+    t_thread workers[THREADS_MAX];
+    auto start = clock::monotonic_now();
+    for (t_n_ ix = 0; ix < threads; ++ix)
+      workers[ix].create(run_, &kind, t_arena_size{ARENA_SIZE});
+    for (t_n_ ix = 0; ix < threads; ++ix)
+      workers[ix].join();
+    auto nsec = elapsed_nsec_(start);
+    std::printf("%-6s %zu threads: %7.1f ns/object\n", name, threads,
+                double(nsec)/(REQUESTS*REQUEST_OBJS*threads));
+  }
+}
+
+int main() {
+  for (t_n_ threads = 1; threads <= THREADS_MAX; threads *= 2) {
+    bench_("malloc", MALLOC, threads);
+    bench_("arena",  ARENA,  threads);
+    bench_("slab",   SLAB,   threads);
+  }
+  return 0;
+}
@@ -0,0 +1,129 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+// per phase cost of t_barrier and t_latch as the thread count grows,
+// against a generation barrier on a t_mutex_lock and t_cond_var::broadcast,
+// the way batch stages were kept in lockstep before.
+//
+// build from the top directory, with dainty_named and dainty_oops on the
+// include path:
+//   g++ -std=c++17 -O2 -I. bench/dainty_os_bench_barrier.cpp dainty_os_*.cpp
+//       -pthread
+
+#include <cstdio>
+#include <memory>
+#include "dainty_os_clock.h"
+#include "dainty_os_threading.h"
+
+using namespace dainty::named;
+using namespace dainty::os;
+using namespace dainty::os::threading;
+using dainty::os::clock::t_time;
+
+namespace
+{
+  constexpr t_n_ THREADS_MAX = 16;
+  constexpr long PHASES      = 20000;
+
+  // the baseline, everyone is woken through one mutex
+  class t_cond_barrier {
+  public:
+    t_cond_barrier(t_n_ parties) noexcept : parties_(parties) {
+    }
+
+    t_void arrive_and_wait() noexcept {
+      auto scope = lock_.make_locked_scope();
+      auto phase = phase_;
+      if (++arrived_ == parties_) {
+        arrived_ = 0;
+        ++phase_;
+        cond_.broadcast();
+      } else {
+        while (phase == phase_)
+          cond_.wait(lock_);
+      }
+    }
+
+  private:
+    t_mutex_lock lock_;
+    t_cond_var   cond_;
+    t_n_         parties_;
+    t_n_         arrived_ = 0;
+    t_n_         phase_   = 0;
+  };
+
+  t_int64 elapsed_nsec_(t_time start) noexcept {
+    auto time = clock::monotonic_now();
+    time -= start;
+    return get(time.to<t_nsec>());
+  }
+
+  // every thread runs PHASES times through phase(ix), the time per phase
+  // is what it costs to bring all threads through one synchronization
+  template<typename F>
+  t_void bench_(const char* name, t_n_ threads, F phase) noexcept {
+    t_thread workers[THREADS_MAX];
+    auto start = clock::monotonic_now();
+    for (t_n_ ix = 0; ix < threads; ++ix)
+      workers[ix].create([&phase]{
+        for (long ix = 0; ix < PHASES; ++ix)
+          phase(ix);
+      });
+    for (t_n_ ix = 0; ix < threads; ++ix)
+      workers[ix].join();
+    auto nsec = elapsed_nsec_(start);
+    std::printf("%-8s %2zu threads: %8.1f ns/phase\n", name, threads,
+                double(nsec)/PHASES);
+  }
+}
+
+int main() {
+  for (t_n_ threads = 2; threads <= THREADS_MAX; threads *= 2) {
+    t_barrier barrier{t_n{threads}};
+    bench_("barrier", threads, [&barrier](long) {
+      barrier.arrive_and_wait();
+    });
+
+    t_cond_barrier cond{threads};
+    bench_("cond_var", threads, [&cond](long) {
+      cond.arrive_and_wait();
+    });
+
+    // a latch is single use, one per phase. the last thread through a
+    // phase resets the latch two phases ahead, which nobody can still be
+    // waiting on or be about to arrive at.
+    std::unique_ptr<t_latch> latches[3];
+    for (auto& latch : latches)
+      latch.reset(new t_latch{t_n{threads}});
+    t_barrier reset{t_n{threads}};
+    bench_("latch", threads, [&latches, &reset, threads](long ix) {
+      latches[ix % 3]->arrive_and_wait();
+      if (reset.arrive_and_wait())
+        latches[(ix + 2) % 3].reset(new t_latch{t_n{threads}});
+    });
+  }
+  return 0;
+}
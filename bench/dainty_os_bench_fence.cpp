@@ -0,0 +1,116 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+// hot side cost of light_fence() against the full fence it replaces, in a
+// loop that publishes a hazard slot and polls a stop flag, and the cost of
+// the slow side's heavy_fence(), alone and while hot threads run.
+//
+// build from the top directory, with dainty_named and dainty_oops on the
+// include path:
+//   g++ -std=c++17 -O2 -I. bench/dainty_os_bench_fence.cpp dainty_os_*.cpp
+//       -pthread
+
+#include <cstdio>
+#include <limits>
+#include "dainty_os_clock.h"
+#include "dainty_os_threading.h"
+
+using namespace dainty::named;
+using namespace dainty::os;
+using namespace dainty::os::threading;
+using dainty::os::clock::t_time;
+
+namespace
+{
+  constexpr long LOOPS  = 1L << 25;
+  constexpr long HEAVY  = 1L << 12;
+  constexpr t_n_ HOT    = 2;
+
+  std::atomic<p_void> hazard_{nullptr};
+  std::atomic<t_bool> stop_{false};
+  int                 object_;
+
+  t_int64 elapsed_nsec_(t_time start) noexcept {
+    auto time = clock::monotonic_now();
+    time -= start;
+    return get(time.to<t_nsec>());
+  }
+
+  // the hot side of hazard publication: store, fence, validate
+  template<typename F>
+  long hot_loop_(long loops, F fence) noexcept {
+    long seen = 0;
+    for (long ix = 0; ix < loops && !stop_.load(std::memory_order_relaxed);
+         ++ix) {
+      hazard_.store(&object_, std::memory_order_relaxed);
+      fence();
+      seen += hazard_.load(std::memory_order_relaxed) == &object_;
+      hazard_.store(nullptr, std::memory_order_relaxed);
+    }
+    return seen;
+  }
+
+  template<typename F>
+  t_void bench_hot_(const char* name, F fence) noexcept {
+    auto start = clock::monotonic_now();
+    long seen  = hot_loop_(LOOPS, fence);
+    auto nsec  = elapsed_nsec_(start);
+    std::printf("hot  %-14s %6.2f ns/loop (%ld)\n", name,
+                double(nsec)/LOOPS, seen);
+  }
+
+  t_void bench_heavy_(const char* name, t_n_ hot) noexcept {
+    t_thread threads[HOT];
+    stop_ = false;
+    for (t_n_ ix = 0; ix < hot; ++ix)
+      threads[ix].create([]{
+        hot_loop_(std::numeric_limits<long>::max(), []{ light_fence(); });
+      });
+    auto start = clock::monotonic_now();
+    for (long ix = 0; ix < HEAVY; ++ix)
+      heavy_fence();
+    auto nsec = elapsed_nsec_(start);
+    stop_ = true;
+    for (t_n_ ix = 0; ix < hot; ++ix)
+      threads[ix].join();
+    std::printf("slow %-14s %8.1f ns/heavy_fence\n", name,
+                double(nsec)/HEAVY);
+  }
+}
+
+int main() {
+  std::printf("membarrier %s\n", has_heavy_fence() ? "registered"
+                                                   : "not available");
+  bench_hot_("light_fence", []{ light_fence(); });
+  bench_hot_("seq_cst fence", []{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  });
+  bench_hot_("no fence", []{ });
+
+  bench_heavy_("alone", 0);
+  bench_heavy_("with 2 hot", HOT);
+  return 0;
+}
@@ -0,0 +1,183 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+// throughput and latency of t_mpmc_queue against a bounded deque behind a
+// t_mutex_lock and two t_cond_var, the way fan-in/fan-out was done before.
+//
+// build from the top directory, with dainty_named and dainty_oops on the
+// include path:
+//   g++ -std=c++17 -O2 -I. bench/dainty_os_bench_mpmc.cpp dainty_os_*.cpp
+//       -pthread
+
+#include <cstdio>
+#include <deque>
+#include "dainty_os_clock.h"
+#include "dainty_os_threading.h"
+
+using namespace dainty::named;
+using namespace dainty::os;
+using namespace dainty::os::threading;
+using dainty::os::clock::t_time;
+
+namespace
+{
+  constexpr t_n_ CAPACITY = 1024;
+  constexpr long TOTAL    = 1L << 21; // items per run, split over the threads
+  constexpr long PAIRS    = 1L << 23; // uncontended try_push/try_pop pairs
+  constexpr long TRIPS    = 1L << 17; // ping pong round trips
+
+  using t_queue = t_mpmc_queue<long, CAPACITY>;
+
+  // the baseline, one lock for both ends
+  class t_locked_queue {
+  public:
+    t_void push(long value) noexcept {
+      auto scope = lock_.make_locked_scope();
+      while (items_.size() == CAPACITY)
+        not_full_.wait(lock_);
+      items_.push_back(value);
+      not_empty_.signal();
+    }
+
+    long pop() noexcept {
+      auto scope = lock_.make_locked_scope();
+      while (items_.empty())
+        not_empty_.wait(lock_);
+      long value = items_.front();
+      items_.pop_front();
+      not_full_.signal();
+      return value;
+    }
+
+  private:
+    t_mutex_lock     lock_;
+    t_cond_var       not_empty_;
+    t_cond_var       not_full_;
+    std::deque<long> items_;
+  };
+
+  t_int64 elapsed_nsec_(t_time start) noexcept {
+    auto time = clock::monotonic_now();
+    time -= start;
+    return get(time.to<t_nsec>());
+  }
+
+  t_void bench_uncontended_() noexcept {
+    static t_queue queue;
+    long value = 0, sum = 0;
+    auto start = clock::monotonic_now();
+    for (long ix = 0; ix < PAIRS; ++ix) {
+      queue.try_push(ix);
+      queue.try_pop(value);
+      sum += value;
+    }
+    auto nsec = elapsed_nsec_(start);
+    std::printf("uncontended try_push+try_pop: %6.1f ns/pair (sum %ld)\n",
+                double(nsec)/PAIRS, sum);
+
+    // what each of them paid when a notify began with a fence
+    start = clock::monotonic_now();
+    for (long ix = 0; ix < PAIRS; ++ix)
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    nsec = elapsed_nsec_(start);
+    std::printf("seq_cst fence:                %6.1f ns\n",
+                double(nsec)/PAIRS);
+  }
+
+  template<typename Q, typename PUSH, typename POP>
+  t_void bench_throughput_(const char* name, t_n_ producers, t_n_ consumers,
+                           PUSH push, POP pop) noexcept {
+    static Q queue;
+    std::atomic<long> sum{0};
+    t_thread threads[16];
+    auto start = clock::monotonic_now();
+    for (t_n_ ix = 0; ix < producers; ++ix)
+      threads[ix].create([&push, producers]{
+        for (long item = 0; item < TOTAL/long(producers); ++item)
+          push(queue, item);
+      });
+    for (t_n_ ix = 0; ix < consumers; ++ix)
+      threads[producers + ix].create([&pop, &sum, consumers]{
+        long local = 0;
+        for (long item = 0; item < TOTAL/long(consumers); ++item)
+          local += pop(queue);
+        sum += local;
+      });
+    for (t_n_ ix = 0; ix < producers + consumers; ++ix)
+      threads[ix].join();
+    auto nsec = elapsed_nsec_(start);
+    std::printf("%-6s %2zup x %2zuc: %7.2f Mitems/s (sum %ld)\n", name,
+                producers, consumers, TOTAL*1000.0/nsec, sum.load());
+  }
+
+  // one item bounces between two threads, half a round trip is the latency
+  // of a handoff including the wakeup of a parked thread
+  template<typename Q, typename PUSH, typename POP>
+  t_void bench_latency_(const char* name, PUSH push, POP pop) noexcept {
+    static Q ping, pong;
+    t_thread echo;
+    echo.create([&push, &pop]{
+      for (long ix = 0; ix < TRIPS; ++ix)
+        push(pong, pop(ping));
+    });
+    auto start = clock::monotonic_now();
+    for (long ix = 0; ix < TRIPS; ++ix) {
+      push(ping, ix);
+      pop(pong);
+    }
+    auto nsec = elapsed_nsec_(start);
+    echo.join();
+    std::printf("%-6s ping pong: %7.1f ns/handoff\n", name,
+                double(nsec)/(2*TRIPS));
+  }
+}
+
+int main() {
+  auto mpmc_push  = [](t_queue& queue, long value) { queue.push(value); };
+  auto mpmc_pop   = [](t_queue& queue) {
+    long value = 0;
+    queue.pop(value);
+    return value;
+  };
+  auto mutex_push = [](t_locked_queue& queue, long value) {
+    queue.push(value);
+  };
+  auto mutex_pop  = [](t_locked_queue& queue) { return queue.pop(); };
+
+  bench_uncontended_();
+
+  const t_n_ counts[][2] = {{1, 1}, {2, 2}, {4, 4}, {1, 4}, {4, 1}, {8, 8}};
+  for (auto& count : counts) {
+    bench_throughput_<t_queue>("mpmc", count[0], count[1],
+                               mpmc_push, mpmc_pop);
+    bench_throughput_<t_locked_queue>("mutex", count[0], count[1],
+                                      mutex_push, mutex_pop);
+  }
+
+  bench_latency_<t_queue>("mpmc", mpmc_push, mpmc_pop);
+  bench_latency_<t_locked_queue>("mutex", mutex_push, mutex_pop);
+  return 0;
+}
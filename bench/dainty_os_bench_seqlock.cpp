@@ -0,0 +1,163 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+// read cost of a 64 byte snapshot with one writer updating it all the time:
+// t_seqlock and t_multi_seqlock against a t_mutex_lock and a
+// pthread_rwlock_t, for a growing number of readers.
+//
+// build from the top directory, with dainty_named and dainty_oops on the
+// include path:
+//   g++ -std=c++17 -O2 -I. bench/dainty_os_bench_seqlock.cpp dainty_os_*.cpp
+//       -pthread
+
+#include <pthread.h>
+#include <cstdio>
+#include "dainty_os_clock.h"
+#include "dainty_os_threading.h"
+
+using namespace dainty::named;
+using namespace dainty::os;
+using namespace dainty::os::threading;
+using dainty::os::clock::t_time;
+
+namespace
+{
+  constexpr t_n_ READERS_MAX = 8;
+  constexpr long READS       = 1L << 21; // per reader
+
+  // the fields always agree, a reader checks that it saw no torn copy
+  struct t_snapshot {
+    t_uint64 fields[8];
+  };
+
+  t_snapshot make_(t_uint64 value) noexcept {
+    t_snapshot snapshot;
+    for (auto& field : snapshot.fields)
+      field = value;
+    return snapshot;
+  }
+
+  t_bool is_torn_(const t_snapshot& snapshot) noexcept {
+    for (auto field : snapshot.fields)
+      if (field != snapshot.fields[0])
+        return true;
+    return false;
+  }
+
+  class t_mutex_snapshot {
+  public:
+    t_void store(const t_snapshot& snapshot) noexcept {
+      auto scope = lock_.make_locked_scope();
+      snapshot_ = snapshot;
+    }
+
+    t_snapshot load() noexcept {
+      auto scope = lock_.make_locked_scope();
+      return snapshot_;
+    }
+
+  private:
+    t_mutex_lock lock_;
+    t_snapshot   snapshot_ = make_(0);
+  };
+
+  class t_rwlock_snapshot {
+  public:
+    t_rwlock_snapshot() noexcept {
+      ::pthread_rwlock_init(&lock_, nullptr);
+    }
+
+    ~t_rwlock_snapshot() {
+      ::pthread_rwlock_destroy(&lock_);
+    }
+
+    t_void store(const t_snapshot& snapshot) noexcept {
+      ::pthread_rwlock_wrlock(&lock_);
+      snapshot_ = snapshot;
+      ::pthread_rwlock_unlock(&lock_);
+    }
+
+    t_snapshot load() noexcept {
+      ::pthread_rwlock_rdlock(&lock_);
+      t_snapshot snapshot = snapshot_;
+      ::pthread_rwlock_unlock(&lock_);
+      return snapshot;
+    }
+
+  private:
+    ::pthread_rwlock_t lock_;
+    t_snapshot         snapshot_ = make_(0);
+  };
+
+  t_int64 elapsed_nsec_(t_time start) noexcept {
+    auto time = clock::monotonic_now();
+    time -= start;
+    return get(time.to<t_nsec>());
+  }
+
+  template<typename L>
+  t_void bench_(const char* name, t_n_ readers) noexcept {
+    static L lock;
+    std::atomic<t_bool> stop{false};
+    std::atomic<long>   torn{0};
+    long                writes = 0;
+
+    t_thread writer;
+    writer.create([&stop, &writes]{
+      for (t_uint64 value = 1; !stop.load(std::memory_order_relaxed);
+           ++value, ++writes)
+        lock.store(make_(value));
+    });
+
+    t_thread workers[READERS_MAX];
+    auto start = clock::monotonic_now();
+    for (t_n_ ix = 0; ix < readers; ++ix)
+      workers[ix].create([&torn]{
+        long local = 0;
+        for (long ix = 0; ix < READS; ++ix)
+          local += is_torn_(lock.load());
+        torn += local;
+      });
+    for (t_n_ ix = 0; ix < readers; ++ix)
+      workers[ix].join();
+    auto nsec = elapsed_nsec_(start);
+    stop = true;
+    writer.join();
+    std::printf("%-10s %zu readers: %7.1f ns/read, %ld writes, %ld torn\n",
+                name, readers, double(nsec)/(READS*readers), writes,
+                torn.load());
+  }
+}
+
+int main() {
+  for (t_n_ readers = 1; readers <= READERS_MAX; readers *= 2) {
+    bench_<t_seqlock<t_snapshot>>      ("seqlock",  readers);
+    bench_<t_multi_seqlock<t_snapshot>>("multi",    readers);
+    bench_<t_mutex_snapshot>           ("mutex",    readers);
+    bench_<t_rwlock_snapshot>          ("rwlock",   readers);
+  }
+  return 0;
+}
@@ -39,6 +39,8 @@
 #include "dainty_os_clock.h"
 #include "dainty_os_networking.h"
 #include "dainty_os_scheduling.h"
+#include "dainty_os_sharding.h"
+#include "dainty_os_tracing.h"
 
 namespace dainty
 {
@@ -25,6 +25,11 @@
 ******************************************************************************/
 
 #include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include "dainty_named_utility.h"
 #include "dainty_os_call.h"
 
@@ -32,6 +37,37 @@ namespace dainty
 {
 namespace os
 {
+  namespace
+  {
+    static_assert(sizeof(t_futex) == sizeof(t_futex_value),
+                  "futex word must be 32 bits");
+
+    inline int futex_(r_futex futex, int op, t_futex_value value,
+                      const ::timespec* spec, t_futex_value mask) noexcept {
+      return ::syscall(SYS_futex, reinterpret_cast<t_futex_value*>(&futex),
+                       op, value, spec, nullptr, mask);
+    }
+
+    inline int futex_op_(int op, t_process_scope scope) noexcept {
+      return scope == PROCESS_PRIVATE ? op | FUTEX_PRIVATE_FLAG : op;
+    }
+
+    inline t_void futex_err_(t_err err, t_errn errn) noexcept {
+      switch (get(errn)) {
+        case 0:
+        case EAGAIN:
+        case EINTR:
+          break;
+        case ETIMEDOUT:
+          err = err::E_TIMEOUT;
+          break;
+        default:
+          err = err::E_XXX;
+          break;
+      }
+    }
+  }
+
 ///////////////////////////////////////////////////////////////////////////////
 
   t_errn call_pthread_init(r_pthread_mutexattr attr) noexcept {
@@ -94,6 +130,82 @@ namespace os
     return false;
   }
 
+///////////////////////////////////////////////////////////////////////////////
+
+  t_errn call_pthread_set_prio_inherit(r_pthread_mutexattr attr) noexcept {
+    return t_errn{::pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT)};
+  }
+
+  t_void call_pthread_set_prio_inherit(t_err err,
+                                       r_pthread_mutexattr attr) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_pthread_set_prio_inherit(attr)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_pthread_set_prio_protect(r_pthread_mutexattr attr,
+                                       t_int ceiling) noexcept {
+    auto errn{::pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_PROTECT)};
+    if (!errn)
+      errn = ::pthread_mutexattr_setprioceiling(&attr, ceiling);
+    return t_errn{errn};
+  }
+
+  t_void call_pthread_set_prio_protect(t_err err, r_pthread_mutexattr attr,
+                                       t_int ceiling) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_pthread_set_prio_protect(attr, ceiling)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_pthread_set_robust(r_pthread_mutexattr attr) noexcept {
+    return t_errn{::pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST)};
+  }
+
+  t_void call_pthread_set_robust(t_err err,
+                                 r_pthread_mutexattr attr) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_pthread_set_robust(attr)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_bool call_pthread_is_robust(R_pthread_mutexattr attr) noexcept {
+    int robust = 0;
+    return ::pthread_mutexattr_getrobust(&attr, &robust) == 0 &&
+           robust == PTHREAD_MUTEX_ROBUST;
+  }
+
+  t_bool call_pthread_is_robust(t_err err,
+                                R_pthread_mutexattr attr) noexcept {
+    ERR_GUARD(err) {
+      int robust = 0;
+      if (::pthread_mutexattr_getrobust(&attr, &robust) == 0)
+        return robust == PTHREAD_MUTEX_ROBUST;
+      err = err::E_XXX;
+    }
+    return false;
+  }
+
+  t_errn call_pthread_set_shared(r_pthread_mutexattr attr) noexcept {
+    return t_errn{::pthread_mutexattr_setpshared(&attr,
+                                                 PTHREAD_PROCESS_SHARED)};
+  }
+
+  t_void call_pthread_set_shared(t_err err,
+                                 r_pthread_mutexattr attr) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_pthread_set_shared(attr)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
 ///////////////////////////////////////////////////////////////////////////////
 
   t_errn call_pthread_mutex_init(r_pthread_mutex mutex) noexcept {
@@ -155,7 +267,25 @@ namespace os
                                       R_timespec spec) noexcept {
     ERR_GUARD(err) {
       auto errn{call_pthread_mutex_timedlock(mutex, spec)};
-      if (errn == INVALID)
+      if (get(errn) == ETIMEDOUT)
+        err = err::E_TIMEOUT;
+      else if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_pthread_mutex_clocklock(r_pthread_mutex mutex, t_clockid clk,
+                                      R_timespec spec) noexcept {
+    return t_errn{::pthread_mutex_clocklock(&mutex, clk, &spec)};
+  }
+
+  t_void call_pthread_mutex_clocklock(t_err err, r_pthread_mutex mutex,
+                                      t_clockid clk, R_timespec spec) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_pthread_mutex_clocklock(mutex, clk, spec)};
+      if (get(errn) == ETIMEDOUT)
+        err = err::E_TIMEOUT;
+      else if (errn == INVALID)
         err = err::E_XXX;
     }
   }
@@ -184,6 +314,19 @@ namespace os
     }
   }
 
+  t_errn call_pthread_mutex_consistent(r_pthread_mutex mutex) noexcept {
+    return t_errn{::pthread_mutex_consistent(&mutex)};
+  }
+
+  t_void call_pthread_mutex_consistent(t_err err,
+                                       r_pthread_mutex mutex) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_pthread_mutex_consistent(mutex)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
 ///////////////////////////////////////////////////////////////////////////////
 
   t_errn call_pthread_init(r_pthread_condattr attr) noexcept {
@@ -320,7 +463,11 @@ namespace os
                                 r_pthread_mutex mutex) noexcept {
     ERR_GUARD(err) {
       auto errn{call_pthread_cond_wait(cond, mutex)};
-      if (errn == INVALID)
+      if (get(errn) == EOWNERDEAD)
+        err = err::E_OWNER_DEAD;
+      else if (get(errn) == ENOTRECOVERABLE)
+        err = err::E_NOT_RECOVERABLE;
+      else if (errn == INVALID)
         err = err::E_XXX;
     }
   }
@@ -336,7 +483,13 @@ namespace os
                                      R_timespec spec) noexcept {
     ERR_GUARD(err) {
       auto errn{call_pthread_cond_timedwait(cond, mutex, spec)};
-      if (errn == INVALID)
+      if (get(errn) == ETIMEDOUT)
+        err = err::E_TIMEOUT;
+      else if (get(errn) == EOWNERDEAD)
+        err = err::E_OWNER_DEAD;
+      else if (get(errn) == ENOTRECOVERABLE)
+        err = err::E_NOT_RECOVERABLE;
+      else if (errn == INVALID)
         err = err::E_XXX;
     }
   }
@@ -355,6 +508,108 @@ namespace os
     }
   }
 
+  t_errn call_pthread_destroy(r_pthread_attr attr) noexcept {
+    return t_errn{::pthread_attr_destroy(&attr)};
+  }
+
+  t_void call_pthread_destroy(t_err err, r_pthread_attr attr) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_pthread_destroy(attr)};
+      if (errn == INVALID)
+        err = err::E_DESTROY_FAIL;
+    }
+  }
+
+  t_errn call_pthread_copy(r_pthread_attr attr, R_pthread_attr from) noexcept {
+    t_errn errn{::pthread_attr_init(&attr)};
+    if (errn == VALID) {
+      int           value = 0;
+      ::sched_param param;
+      ::cpu_set_t   set;
+      errn = t_errn{::pthread_attr_getdetachstate(&from, &value)};
+      if (errn == VALID)
+        errn = t_errn{::pthread_attr_setdetachstate(&attr, value)};
+      if (errn == VALID)
+        errn = t_errn{::pthread_attr_getinheritsched(&from, &value)};
+      if (errn == VALID)
+        errn = t_errn{::pthread_attr_setinheritsched(&attr, value)};
+      if (errn == VALID)
+        errn = t_errn{::pthread_attr_getschedpolicy(&from, &value)};
+      if (errn == VALID)
+        errn = t_errn{::pthread_attr_setschedpolicy(&attr, value)};
+      if (errn == VALID)
+        errn = t_errn{::pthread_attr_getschedparam(&from, &param)};
+      if (errn == VALID)
+        errn = t_errn{::pthread_attr_setschedparam(&attr, &param)};
+      if (errn == VALID)
+        errn = t_errn{::pthread_attr_getscope(&from, &value)};
+      if (errn == VALID)
+        errn = t_errn{::pthread_attr_setscope(&attr, value)};
+      // an attr without affinity reads back as every cpu
+      if (errn == VALID)
+        errn = t_errn{::pthread_attr_getaffinity_np(&from, sizeof(set), &set)};
+      if (errn == VALID && CPU_COUNT(&set) < CPU_SETSIZE)
+        errn = t_errn{::pthread_attr_setaffinity_np(&attr, sizeof(set), &set)};
+      if (errn == INVALID)
+        ::pthread_attr_destroy(&attr);
+    }
+    return errn;
+  }
+
+  t_void call_pthread_copy(t_err err, r_pthread_attr attr,
+                           R_pthread_attr from) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_pthread_copy(attr, from)};
+      if (errn == INVALID)
+        err = err::E_INIT_FAIL;
+    }
+  }
+
+  t_errn call_pthread_set_stack(r_pthread_attr attr, p_void ptr,
+                                t_n size) noexcept {
+    return t_errn{::pthread_attr_setstack(&attr, ptr, get(size))};
+  }
+
+  t_void call_pthread_set_stack(t_err err, r_pthread_attr attr, p_void ptr,
+                                t_n size) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_pthread_set_stack(attr, ptr, size)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_pthread_get_stack(R_pthread_attr attr, p_void& ptr,
+                                t_n& size) noexcept {
+    ::size_t bytes = 0;
+    t_errn errn{::pthread_attr_getstack(&attr, &ptr, &bytes)};
+    if (errn == VALID)
+      size = t_n{bytes};
+    return errn;
+  }
+
+  t_void call_pthread_get_stack(t_err err, R_pthread_attr attr, p_void& ptr,
+                                t_n& size) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_pthread_get_stack(attr, ptr, size)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_pthread_getattr(R_pthread thread, r_pthread_attr attr) noexcept {
+    return t_errn{::pthread_getattr_np(thread, &attr)};
+  }
+
+  t_void call_pthread_getattr(t_err err, R_pthread thread,
+                              r_pthread_attr attr) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_pthread_getattr(thread, attr)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
   t_errn call_pthread_set_stacksize(r_pthread_attr attr,
                                     t_pthread_attr_stacksize size) noexcept {
     return t_errn{::pthread_attr_setstacksize(&attr, get(size))};
@@ -410,6 +665,22 @@ namespace os
     }
   }
 
+  t_errn call_pthread_set_affinity(r_pthread_attr attr, t_n cpu) noexcept {
+    ::cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(get(cpu), &set);
+    return t_errn{::pthread_attr_setaffinity_np(&attr, sizeof(set), &set)};
+  }
+
+  t_void call_pthread_set_affinity(t_err err, r_pthread_attr attr,
+                                   t_n cpu) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_pthread_set_affinity(attr, cpu)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
   t_errn call_pthread_set_detach(r_pthread_attr attr) noexcept {
     return t_errn{::pthread_attr_setdetachstate(&attr,
                                                 PTHREAD_CREATE_DETACHED)};
@@ -451,6 +722,45 @@ namespace os
     return ::pthread_equal(p1, p2);
   }
 
+  t_void call_sched_yield() noexcept {
+    ::sched_yield();
+  }
+
+  t_n call_get_nprocs() noexcept {
+    return t_n(::sysconf(_SC_NPROCESSORS_ONLN));
+  }
+
+  t_n call_get_nprocs_conf() noexcept {
+    return t_n(::sysconf(_SC_NPROCESSORS_CONF));
+  }
+
+  t_n call_sched_getcpu() noexcept {
+    auto cpu = ::sched_getcpu();
+    return t_n(cpu >= 0 ? cpu : 0);
+  }
+
+  t_errn call_sched_getaffinity(r_cpu_set set) noexcept {
+    if (::sched_getaffinity(0, sizeof(set), &set) == 0)
+      return t_errn{0};
+    return t_errn{errno};
+  }
+
+  t_void call_sched_getaffinity(t_err err, r_cpu_set set) noexcept {
+    ERR_GUARD(err) {
+      if (call_sched_getaffinity(set) == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_pid call_gettid() noexcept {
+    return t_pid(::syscall(SYS_gettid));
+  }
+
+  t_clockid call_thread_cpuclock(t_pid tid) noexcept {
+    // MAKE_THREAD_CPUCLOCK(tid, CPUCLOCK_SCHED) from the kernel
+    return t_clockid((~static_cast<unsigned>(tid) << 3) | 6);
+  }
+
   t_errn call_pthread_create(r_pthread thread, p_run run,
                              p_void arg) noexcept {
     return t_errn{::pthread_create(&thread, NULL, run, arg)};
@@ -604,6 +914,134 @@ namespace os
     }
   }
 
+  t_errn call_clock_gettime_monotonic_coarse(r_timespec spec) noexcept {
+    return t_errn{::clock_gettime(CLOCK_MONOTONIC_COARSE, &spec)};
+  }
+
+  t_void call_clock_gettime_monotonic_coarse(t_err err,
+                                             r_timespec spec) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_clock_gettime_monotonic_coarse(spec)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_clock_gettime_realtime_coarse(r_timespec spec) noexcept {
+    return t_errn{::clock_gettime(CLOCK_REALTIME_COARSE, &spec)};
+  }
+
+  t_void call_clock_gettime_realtime_coarse(t_err err,
+                                            r_timespec spec) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_clock_gettime_realtime_coarse(spec)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_clock_nanosleep(t_clockid clock, t_int flags,
+                              R_timespec spec) noexcept {
+    return t_errn{::clock_nanosleep(clock, flags, &spec, nullptr)};
+  }
+
+  t_void call_clock_nanosleep(t_err err, t_clockid clock, t_int flags,
+                              R_timespec spec) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_clock_nanosleep(clock, flags, spec)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_errn call_futex_wait(r_futex futex, t_futex_value value) noexcept {
+    return call_futex_wait(futex, value, PROCESS_PRIVATE);
+  }
+
+  t_void call_futex_wait(t_err err, r_futex futex,
+                         t_futex_value value) noexcept {
+    call_futex_wait(err, futex, value, PROCESS_PRIVATE);
+  }
+
+  t_errn call_futex_wait_until(r_futex futex, t_futex_value value,
+                               R_timespec spec) noexcept {
+    return call_futex_wait_until(futex, value, spec, PROCESS_PRIVATE);
+  }
+
+  t_void call_futex_wait_until(t_err err, r_futex futex, t_futex_value value,
+                               R_timespec spec) noexcept {
+    call_futex_wait_until(err, futex, value, spec, PROCESS_PRIVATE);
+  }
+
+  t_verify<t_n> call_futex_wake(r_futex futex, t_n n) noexcept {
+    return call_futex_wake(futex, n, PROCESS_PRIVATE);
+  }
+
+  t_n call_futex_wake(t_err err, r_futex futex, t_n n) noexcept {
+    return call_futex_wake(err, futex, n, PROCESS_PRIVATE);
+  }
+
+  t_verify<t_n> call_futex_wake_all(r_futex futex) noexcept {
+    return call_futex_wake(futex, t_n{INT_MAX}, PROCESS_PRIVATE);
+  }
+
+  t_n call_futex_wake_all(t_err err, r_futex futex) noexcept {
+    return call_futex_wake(err, futex, t_n{INT_MAX}, PROCESS_PRIVATE);
+  }
+
+  t_errn call_futex_wait(r_futex futex, t_futex_value value,
+                         t_process_scope scope) noexcept {
+    if (futex_(futex, futex_op_(FUTEX_WAIT, scope), value, nullptr, 0) == 0)
+      return t_errn{0};
+    return t_errn{errno};
+  }
+
+  t_void call_futex_wait(t_err err, r_futex futex, t_futex_value value,
+                         t_process_scope scope) noexcept {
+    ERR_GUARD(err) {
+      futex_err_(err, call_futex_wait(futex, value, scope));
+    }
+  }
+
+  t_errn call_futex_wait_until(r_futex futex, t_futex_value value,
+                               R_timespec spec,
+                               t_process_scope scope) noexcept {
+    if (futex_(futex, futex_op_(FUTEX_WAIT_BITSET, scope), value, &spec,
+               FUTEX_BITSET_MATCH_ANY) == 0)
+      return t_errn{0};
+    return t_errn{errno};
+  }
+
+  t_void call_futex_wait_until(t_err err, r_futex futex, t_futex_value value,
+                               R_timespec spec,
+                               t_process_scope scope) noexcept {
+    ERR_GUARD(err) {
+      futex_err_(err, call_futex_wait_until(futex, value, spec, scope));
+    }
+  }
+
+  t_verify<t_n> call_futex_wake(r_futex futex, t_n n,
+                                t_process_scope scope) noexcept {
+    auto ret = futex_(futex, futex_op_(FUTEX_WAKE, scope),
+                      get(n) > INT_MAX ? INT_MAX : get(n), nullptr, 0);
+    if (ret >= 0)
+      return {t_n(ret), t_errn{0}};
+    return {t_n{0}, t_errn{errno}};
+  }
+
+  t_n call_futex_wake(t_err err, r_futex futex, t_n n,
+                      t_process_scope scope) noexcept {
+    ERR_GUARD(err) {
+      auto verify = call_futex_wake(futex, n, scope);
+      if (verify == VALID)
+        return verify.value;
+      err = err::E_XXX;
+    }
+    return t_n{0};
+  }
+
 ///////////////////////////////////////////////////////////////////////////////
 
   t_verify<t_fd> call_epoll_create() noexcept {
@@ -719,6 +1157,31 @@ namespace os
 
 ///////////////////////////////////////////////////////////////////////////////
 
+  t_verify<t_fd> call_open(P_cstr path, t_int flags) noexcept {
+    return call_open(path, flags, 0);
+  }
+
+  t_fd call_open(t_err err, P_cstr path, t_int flags) noexcept {
+    return call_open(err, path, flags, 0);
+  }
+
+  t_verify<t_fd> call_open(P_cstr path, t_int flags, t_int mode) noexcept {
+    auto fd = ::open(get(path), flags | O_CLOEXEC, mode);
+    if (fd >= 0)
+      return {t_fd{fd}, t_errn{0}};
+    return {BAD_FD, t_errn{fd}};
+  }
+
+  t_fd call_open(t_err err, P_cstr path, t_int flags, t_int mode) noexcept {
+    ERR_GUARD(err) {
+      auto verify = call_open(path, flags, mode);
+      if (verify == VALID)
+        return verify.value;
+      err = err::E_XXX;
+    }
+    return BAD_FD;
+  }
+
   t_errn call_close(t_fd& fd) noexcept {
     if (fd != BAD_FD)
       return t_errn{::close(get(named::utility::reset(fd, BAD_FD)))};
@@ -831,6 +1294,165 @@ namespace os
     return t_n{0};
   }
 
+///////////////////////////////////////////////////////////////////////////////
+
+  t_verify<t_n> call_recv(t_fd fd, p_void buf, t_n cnt,
+                          t_int flags) noexcept {
+    auto ret = ::recv(get(fd), buf, get(cnt), flags);
+    if (ret >= 0)
+      return {t_n(ret), t_errn{0}};
+    return {t_n{0}, t_errn{errno}};
+  }
+
+  t_n call_recv(t_err err, t_fd fd, p_void buf, t_n cnt,
+                t_int flags) noexcept {
+    ERR_GUARD(err) {
+      auto verify = call_recv(fd, buf, cnt, flags);
+      if (verify == VALID)
+        return verify.value;
+      err = err::E_XXX;
+    }
+    return t_n{0};
+  }
+
+  t_verify<t_n> call_send(t_fd fd, P_void buf, t_n cnt,
+                          t_int flags) noexcept {
+    auto ret = ::send(get(fd), buf, get(cnt), flags | MSG_NOSIGNAL);
+    if (ret >= 0)
+      return {t_n(ret), t_errn{0}};
+    return {t_n{0}, t_errn{errno}};
+  }
+
+  t_n call_send(t_err err, t_fd fd, P_void buf, t_n cnt,
+                t_int flags) noexcept {
+    ERR_GUARD(err) {
+      auto verify = call_send(fd, buf, cnt, flags);
+      if (verify == VALID)
+        return verify.value;
+      err = err::E_XXX;
+    }
+    return t_n{0};
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_verify<p_void> call_mmap(t_n size, t_int prot, t_int flags) noexcept {
+    auto ptr = ::mmap(NULL, get(size), prot,
+                      flags | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr != MAP_FAILED)
+      return {ptr, t_errn{0}};
+    return {nullptr, t_errn{errno}};
+  }
+
+  p_void call_mmap(t_err err, t_n size, t_int prot, t_int flags) noexcept {
+    ERR_GUARD(err) {
+      auto verify = call_mmap(size, prot, flags);
+      if (verify == VALID)
+        return verify.value;
+      err = err::E_XXX;
+    }
+    return nullptr;
+  }
+
+  t_errn call_munmap(p_void ptr, t_n size) noexcept {
+    return t_errn{::munmap(ptr, get(size))};
+  }
+
+  t_void call_munmap(t_err err, p_void ptr, t_n size) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_munmap(ptr, size)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_mprotect(p_void ptr, t_n size, t_int prot) noexcept {
+    return t_errn{::mprotect(ptr, get(size), prot)};
+  }
+
+  t_void call_mprotect(t_err err, p_void ptr, t_n size, t_int prot) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_mprotect(ptr, size, prot)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_n call_getpagesize() noexcept {
+    return t_n(::sysconf(_SC_PAGESIZE));
+  }
+
+  t_errn call_mlock(p_void ptr, t_n size) noexcept {
+    return t_errn{::mlock(ptr, get(size))};
+  }
+
+  t_void call_mlock(t_err err, p_void ptr, t_n size) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_mlock(ptr, size)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_munlock(p_void ptr, t_n size) noexcept {
+    return t_errn{::munlock(ptr, get(size))};
+  }
+
+  t_void call_munlock(t_err err, p_void ptr, t_n size) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_munlock(ptr, size)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_mlockall(t_int flags) noexcept {
+    return t_errn{::mlockall(flags)};
+  }
+
+  t_void call_mlockall(t_err err, t_int flags) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_mlockall(flags)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_munlockall() noexcept {
+    return t_errn{::munlockall()};
+  }
+
+  t_void call_munlockall(t_err err) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_munlockall()};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_mallopt(t_int param, t_int value) noexcept {
+    return t_errn{::mallopt(param, value) == 1 ? 0 : -1};
+  }
+
+  t_void call_mallopt(t_err err, t_int param, t_int value) noexcept {
+    ERR_GUARD(err) {
+      auto errn{call_mallopt(param, value)};
+      if (errn == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn call_membarrier(t_int cmd) noexcept {
+    return t_errn(::syscall(SYS_membarrier, cmd, 0));
+  }
+
+  t_void call_membarrier(t_err err, t_int cmd) noexcept {
+    ERR_GUARD(err) {
+      if (call_membarrier(cmd) == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
@@ -30,9 +30,12 @@
 #include <sys/timerfd.h>
 #include <sys/eventfd.h>
 #include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <pthread.h>
 #include <time.h>
 #include <unistd.h>
+#include <atomic>
 #include "dainty_named.h"
 #include "dainty_os_err.h"
 
@@ -86,6 +89,7 @@ namespace os
   using t_pthread_attr      = t_prefix<::pthread_attr_t>::t_;
   using r_pthread_attr      = t_prefix<::pthread_attr_t>::r_;
   using R_pthread_attr      = t_prefix<::pthread_attr_t>::R_;
+  using P_pthread_attr      = t_prefix<::pthread_attr_t>::P_;
 
   using t_pthread           = t_prefix<::pthread_t>::t_;
   using r_pthread           = t_prefix<::pthread_t>::r_;
@@ -96,6 +100,9 @@ namespace os
   using R_timespec          = t_prefix<::timespec>::R_;
 
   using t_clockid           = t_prefix<::clockid_t>::t_;
+  using t_pid               = t_prefix<::pid_t>::t_;
+  using t_cpu_set           = t_prefix<::cpu_set_t>::t_;
+  using r_cpu_set           = t_prefix<::cpu_set_t>::r_;
 
   using t_epoll_event       = t_prefix<::epoll_event>::t_;
   using r_epoll_event       = t_prefix<::epoll_event>::r_;
@@ -105,6 +112,12 @@ namespace os
   using r_itimerspec        = t_prefix<::itimerspec>::r_;
   using R_itimerspec        = t_prefix<::itimerspec>::R_;
 
+  enum  t_process_scope { PROCESS_PRIVATE, PROCESS_SHARED };
+
+  using t_futex_value       = named::t_uint32;
+  using t_futex             = std::atomic<t_futex_value>;
+  using r_futex             = t_prefix<t_futex>::r_;
+
   enum  t_pthread_attr_stacksize_tag {};
   using t_pthread_attr_stacksize = t_explicit<::size_t,
                                               t_pthread_attr_stacksize_tag>;
@@ -131,6 +144,23 @@ namespace os
   t_bool call_pthread_is_recursive(       R_pthread_mutexattr) noexcept;
   t_bool call_pthread_is_recursive(t_err, R_pthread_mutexattr) noexcept;
 
+  t_errn call_pthread_set_prio_inherit(       r_pthread_mutexattr) noexcept;
+  t_void call_pthread_set_prio_inherit(t_err, r_pthread_mutexattr) noexcept;
+
+  t_errn call_pthread_set_prio_protect(       r_pthread_mutexattr,
+                                              t_int ceiling) noexcept;
+  t_void call_pthread_set_prio_protect(t_err, r_pthread_mutexattr,
+                                              t_int ceiling) noexcept;
+
+  t_errn call_pthread_set_robust(       r_pthread_mutexattr) noexcept;
+  t_void call_pthread_set_robust(t_err, r_pthread_mutexattr) noexcept;
+
+  t_bool call_pthread_is_robust(       R_pthread_mutexattr) noexcept;
+  t_bool call_pthread_is_robust(t_err, R_pthread_mutexattr) noexcept;
+
+  t_errn call_pthread_set_shared(       r_pthread_mutexattr) noexcept;
+  t_void call_pthread_set_shared(t_err, r_pthread_mutexattr) noexcept;
+
 ///////////////////////////////////////////////////////////////////////////////
 
   t_errn call_pthread_mutex_init(       r_pthread_mutex) noexcept;
@@ -152,12 +182,20 @@ namespace os
   t_void call_pthread_mutex_timedlock(t_err, r_pthread_mutex,
                                              R_timespec) noexcept;
 
+  t_errn call_pthread_mutex_clocklock(       r_pthread_mutex, t_clockid,
+                                             R_timespec) noexcept;
+  t_void call_pthread_mutex_clocklock(t_err, r_pthread_mutex, t_clockid,
+                                             R_timespec) noexcept;
+
   t_errn call_pthread_mutex_trylock(       r_pthread_mutex) noexcept;
   t_void call_pthread_mutex_trylock(t_err, r_pthread_mutex) noexcept;
 
   t_errn call_pthread_mutex_unlock(       r_pthread_mutex) noexcept;
   t_void call_pthread_mutex_unlock(t_err, r_pthread_mutex) noexcept;
 
+  t_errn call_pthread_mutex_consistent(       r_pthread_mutex) noexcept;
+  t_void call_pthread_mutex_consistent(t_err, r_pthread_mutex) noexcept;
+
 ///////////////////////////////////////////////////////////////////////////////
 
   t_errn call_pthread_init(       r_pthread_condattr) noexcept;
@@ -206,6 +244,24 @@ namespace os
   t_errn call_pthread_init(       r_pthread_attr) noexcept;
   t_void call_pthread_init(t_err, r_pthread_attr) noexcept;
 
+  t_errn call_pthread_destroy(       r_pthread_attr) noexcept;
+  t_void call_pthread_destroy(t_err, r_pthread_attr) noexcept;
+
+  // init attr with the detach, scheduling, scope and affinity settings of
+  // another one. its stack is not copied.
+  t_errn call_pthread_copy(       r_pthread_attr, R_pthread_attr) noexcept;
+  t_void call_pthread_copy(t_err, r_pthread_attr, R_pthread_attr) noexcept;
+
+  t_errn call_pthread_set_stack(       r_pthread_attr, p_void, t_n) noexcept;
+  t_void call_pthread_set_stack(t_err, r_pthread_attr, p_void, t_n) noexcept;
+
+  t_errn call_pthread_get_stack(       R_pthread_attr, p_void&, t_n&) noexcept;
+  t_void call_pthread_get_stack(t_err, R_pthread_attr, p_void&, t_n&) noexcept;
+
+  // attributes of a running thread, destroy them after use
+  t_errn call_pthread_getattr(       R_pthread, r_pthread_attr) noexcept;
+  t_void call_pthread_getattr(t_err, R_pthread, r_pthread_attr) noexcept;
+
   t_errn call_pthread_set_stacksize(       r_pthread_attr,
                                            t_pthread_attr_stacksize) noexcept;
   t_void call_pthread_set_stacksize(t_err, r_pthread_attr,
@@ -225,6 +281,10 @@ namespace os
   t_errn call_pthread_set_detach(       r_pthread_attr) noexcept;
   t_void call_pthread_set_detach(t_err, r_pthread_attr) noexcept;
 
+  // pin the thread to a single cpu
+  t_errn call_pthread_set_affinity(       r_pthread_attr, t_n cpu) noexcept;
+  t_void call_pthread_set_affinity(t_err, r_pthread_attr, t_n cpu) noexcept;
+
   t_bool call_pthread_is_detach(       R_pthread_attr) noexcept;
   t_bool call_pthread_is_detach(t_err, R_pthread_attr) noexcept;
 
@@ -233,6 +293,21 @@ namespace os
   t_pthread call_pthread_self() noexcept;
   t_pthread call_pthread_self() noexcept;
   t_bool    call_pthread_equal(R_pthread, R_pthread) noexcept;
+  t_void    call_sched_yield() noexcept;
+  t_n       call_get_nprocs()  noexcept;
+  t_n       call_get_nprocs_conf() noexcept;
+  t_pid     call_gettid()      noexcept;
+
+  // 0 when the cpu cannot be determined
+  t_n       call_sched_getcpu() noexcept;
+
+  // cpus the calling thread may run on
+  t_errn    call_sched_getaffinity(       r_cpu_set) noexcept;
+  t_void    call_sched_getaffinity(t_err, r_cpu_set) noexcept;
+
+  // cpu clock of any thread of this process, clock_gettime fails once the
+  // thread has exited. unlike pthread_getcpuclockid it needs no pthread_t.
+  t_clockid call_thread_cpuclock(t_pid tid) noexcept;
 
   t_errn call_pthread_create(       r_pthread, p_run, p_void) noexcept;
   t_void call_pthread_create(t_err, r_pthread, p_run, p_void) noexcept;
@@ -274,6 +349,49 @@ namespace os
   t_errn call_clock_gettime_realtime(       r_timespec) noexcept;
   t_void call_clock_gettime_realtime(t_err, r_timespec) noexcept;
 
+  // jiffy resolution, a vdso read without the tsc
+  t_errn call_clock_gettime_monotonic_coarse(       r_timespec) noexcept;
+  t_void call_clock_gettime_monotonic_coarse(t_err, r_timespec) noexcept;
+
+  t_errn call_clock_gettime_realtime_coarse(       r_timespec) noexcept;
+  t_void call_clock_gettime_realtime_coarse(t_err, r_timespec) noexcept;
+
+  // flags: 0 or TIMER_ABSTIME. errn is the error number, EINTR included
+  t_errn call_clock_nanosleep(       t_clockid, t_int flags,
+                                     R_timespec) noexcept;
+  t_void call_clock_nanosleep(t_err, t_clockid, t_int flags,
+                                     R_timespec) noexcept;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_errn call_futex_wait(       r_futex, t_futex_value) noexcept;
+  t_void call_futex_wait(t_err, r_futex, t_futex_value) noexcept;
+
+  // absolute CLOCK_MONOTONIC deadline
+  t_errn call_futex_wait_until(       r_futex, t_futex_value,
+                                      R_timespec) noexcept;
+  t_void call_futex_wait_until(t_err, r_futex, t_futex_value,
+                                      R_timespec) noexcept;
+
+  t_verify<t_n> call_futex_wake(       r_futex, t_n) noexcept;
+  t_n           call_futex_wake(t_err, r_futex, t_n) noexcept;
+
+  t_verify<t_n> call_futex_wake_all(       r_futex) noexcept;
+  t_n           call_futex_wake_all(t_err, r_futex) noexcept;
+
+  t_errn call_futex_wait(       r_futex, t_futex_value,
+                                t_process_scope) noexcept;
+  t_void call_futex_wait(t_err, r_futex, t_futex_value,
+                                t_process_scope) noexcept;
+
+  t_errn call_futex_wait_until(       r_futex, t_futex_value, R_timespec,
+                                      t_process_scope) noexcept;
+  t_void call_futex_wait_until(t_err, r_futex, t_futex_value, R_timespec,
+                                      t_process_scope) noexcept;
+
+  t_verify<t_n> call_futex_wake(       r_futex, t_n, t_process_scope) noexcept;
+  t_n           call_futex_wake(t_err, r_futex, t_n, t_process_scope) noexcept;
+
 ///////////////////////////////////////////////////////////////////////////////
 
   t_verify<t_fd> call_epoll_create()      noexcept;
@@ -319,6 +437,16 @@ namespace os
 
 ///////////////////////////////////////////////////////////////////////////////
 
+  // flags: O_XXX
+  t_verify<t_fd> call_open(       P_cstr path, t_int flags) noexcept;
+  t_fd           call_open(t_err, P_cstr path, t_int flags) noexcept;
+
+  // mode is used with O_CREAT
+  t_verify<t_fd> call_open(       P_cstr path, t_int flags,
+                                  t_int mode) noexcept;
+  t_fd           call_open(t_err, P_cstr path, t_int flags,
+                                  t_int mode) noexcept;
+
   t_errn     call_close(       t_fd&) noexcept;
   t_void     call_close(t_err, t_fd&) noexcept;
 
@@ -332,6 +460,41 @@ namespace os
 
   // readv, writev
 
+///////////////////////////////////////////////////////////////////////////////
+
+  // prot: PROT_XXX, flags: MAP_XXX - always anonymous and private
+  t_verify<p_void> call_mmap(       t_n, t_int prot, t_int flags) noexcept;
+  p_void           call_mmap(t_err, t_n, t_int prot, t_int flags) noexcept;
+
+  t_errn call_munmap(       p_void, t_n) noexcept;
+  t_void call_munmap(t_err, p_void, t_n) noexcept;
+
+  t_errn call_mprotect(       p_void, t_n, t_int prot) noexcept;
+  t_void call_mprotect(t_err, p_void, t_n, t_int prot) noexcept;
+
+  t_n call_getpagesize() noexcept;
+
+  t_errn call_mlock(       p_void, t_n) noexcept;
+  t_void call_mlock(t_err, p_void, t_n) noexcept;
+
+  t_errn call_munlock(       p_void, t_n) noexcept;
+  t_void call_munlock(t_err, p_void, t_n) noexcept;
+
+  // flags: MCL_XXX
+  t_errn call_mlockall(       t_int flags) noexcept;
+  t_void call_mlockall(t_err, t_int flags) noexcept;
+
+  t_errn call_munlockall()      noexcept;
+  t_void call_munlockall(t_err) noexcept;
+
+  // param: M_XXX
+  t_errn call_mallopt(       t_int param, t_int value) noexcept;
+  t_void call_mallopt(t_err, t_int param, t_int value) noexcept;
+
+  // cmd: MEMBARRIER_CMD_XXX, not QUERY which returns a mask
+  t_errn call_membarrier(       t_int cmd) noexcept;
+  t_void call_membarrier(t_err, t_int cmd) noexcept;
+
 ///////////////////////////////////////////////////////////////////////////////
 
   // signal
@@ -340,6 +503,13 @@ namespace os
 
   // socket api
 
+  // errn is the errno value on failure, so EAGAIN can be told apart
+  t_verify<t_n> call_recv(       t_fd, p_void, t_n, t_int flags) noexcept;
+  t_n           call_recv(t_err, t_fd, p_void, t_n, t_int flags) noexcept;
+
+  t_verify<t_n> call_send(       t_fd, P_void, t_n, t_int flags) noexcept;
+  t_n           call_send(t_err, t_fd, P_void, t_n, t_int flags) noexcept;
+
 ///////////////////////////////////////////////////////////////////////////////
 
   // pipe
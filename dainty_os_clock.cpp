@@ -24,6 +24,10 @@
 
 ******************************************************************************/
 
+#include <errno.h>
+#if (defined(__x86_64__))
+#include <cpuid.h>
+#endif
 #include "dainty_named_assert.h"
 #include "dainty_os_clock.h"
 
@@ -34,38 +38,418 @@ namespace os
 namespace clock
 {
   t_time monotonic_now() {
-    t_time time;
-    if (call_clock_gettime_monotonic(to_(time)) == VALID)
-      return time;
+    ::timespec spec;
+    if (call_clock_gettime_monotonic(spec) == VALID) {
+      t_time time;
+      return to_(time, spec);
+    }
     assert_now(P_cstr("could not read the monotonic time"));
     return {};
   }
 
   t_time monotonic_now(t_err err) {
     ERR_GUARD(err) {
-      t_time time;
-      call_clock_gettime_monotonic(err, to_(time));
-      return time;
+      ::timespec spec;
+      call_clock_gettime_monotonic(err, spec);
+      if (!err) {
+        t_time time;
+        return to_(time, spec);
+      }
     }
     return {};
   }
 
   t_time realtime_now() {
-    t_time time;
-    if (call_clock_gettime_realtime(to_(time)) == VALID)
-      return time;
+    ::timespec spec;
+    if (call_clock_gettime_realtime(spec) == VALID) {
+      t_time time;
+      return to_(time, spec);
+    }
     assert_now(P_cstr("could not read the realtime time"));
     return {};
   }
 
   t_time realtime_now(t_err err) {
     ERR_GUARD(err) {
+      ::timespec spec;
+      call_clock_gettime_realtime(err, spec);
+      if (!err) {
+        t_time time;
+        return to_(time, spec);
+      }
+    }
+    return {};
+  }
+
+  t_time monotonic_coarse_now() {
+    ::timespec spec;
+    if (call_clock_gettime_monotonic_coarse(spec) == VALID) {
       t_time time;
-      call_clock_gettime_realtime(err, to_(time));
-      return time;
+      return to_(time, spec);
+    }
+    assert_now(P_cstr("could not read the coarse monotonic time"));
+    return {};
+  }
+
+  t_time monotonic_coarse_now(t_err err) {
+    ERR_GUARD(err) {
+      ::timespec spec;
+      call_clock_gettime_monotonic_coarse(err, spec);
+      if (!err) {
+        t_time time;
+        return to_(time, spec);
+      }
     }
     return {};
   }
+
+  t_time realtime_coarse_now() {
+    ::timespec spec;
+    if (call_clock_gettime_realtime_coarse(spec) == VALID) {
+      t_time time;
+      return to_(time, spec);
+    }
+    assert_now(P_cstr("could not read the coarse realtime time"));
+    return {};
+  }
+
+  t_time realtime_coarse_now(t_err err) {
+    ERR_GUARD(err) {
+      ::timespec spec;
+      call_clock_gettime_realtime_coarse(err, spec);
+      if (!err) {
+        t_time time;
+        return to_(time, spec);
+      }
+    }
+    return {};
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_cached_now::t_cached_now() noexcept {
+    tick();
+  }
+
+  t_cached_now::~t_cached_now() {
+    stop();
+  }
+
+  t_time t_cached_now::tick() noexcept {
+    return store_(monotonic_now());
+  }
+
+  t_time t_cached_now::tick_coarse() noexcept {
+    return store_(monotonic_coarse_now());
+  }
+
+  t_time t_cached_now::store_(t_time now) noexcept {
+    // the coarse clock lags the fine one, keep whichever is further on
+    auto nsec = to_nsec_(now);
+    auto prev = nsec_.load(std::memory_order_relaxed);
+    while (prev < nsec &&
+           !nsec_.compare_exchange_weak(prev, nsec, std::memory_order_relaxed))
+      ;
+    return prev < nsec ? now : t_time{t_nsec(prev)};
+  }
+
+  t_errn t_cached_now::start(t_time period) noexcept {
+    t_errn errn{-1};
+    named::t_int64 idle = 0;
+    if (to_nsec_(period) > 0 &&
+        period_.compare_exchange_strong(idle, to_nsec_(period),
+                                        std::memory_order_relaxed)) {
+      errn = call_pthread_create(thread_, run_, this);
+      if (errn == INVALID)
+        period_.store(0, std::memory_order_relaxed);
+    }
+    return errn;
+  }
+
+  t_void t_cached_now::start(t_err err, t_time period) noexcept {
+    ERR_GUARD(err) {
+      if (start(period) == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_void t_cached_now::stop() noexcept {
+    if (period_.exchange(0, std::memory_order_relaxed))
+      call_pthread_join(thread_);
+  }
+
+  p_void t_cached_now::run_(p_void arg) noexcept {
+    auto& self = *static_cast<t_cached_now*>(arg);
+    t_time next{self.tick()};
+    for (auto period = self.period_.load(std::memory_order_relaxed); period;
+         period = self.period_.load(std::memory_order_relaxed)) {
+      next += t_nsec(period);
+      auto spec = to_(next);
+      call_clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, spec);
+      self.tick();
+    }
+    return nullptr;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_deadline::t_deadline(t_time time) noexcept : time_{monotonic_now()} {
+    time_ += time;
+  }
+
+  t_deadline::t_deadline(t_err err, t_time time) noexcept
+    : time_{monotonic_now(err)} {
+    time_ += time;
+  }
+
+  t_bool t_deadline::is_expired() const noexcept {
+    return monotonic_now() >= time_;
+  }
+
+  t_time t_deadline::get_remaining() const noexcept {
+    t_time now{monotonic_now()};
+    if (now >= time_)
+      return {};
+    t_time remaining{time_};
+    return remaining -= now;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_periodic::t_periodic(t_time period, t_time spin) noexcept
+    : period_{to_nsec_(period) > 0 ? to_nsec_(period) : 1},
+      spin_  {to_nsec_(spin)   > 0 ? to_nsec_(spin)   : 0} {
+    start();
+  }
+
+  // calibrates the tsc, if not done yet, before the first deadline is set
+  t_void t_periodic::start() noexcept {
+#if (defined(__x86_64__))
+    get_tsc_params();
+#endif
+    deadline_ = now_() + period_;
+  }
+
+  named::t_int64 t_periodic::now_() const noexcept {
+    return to_nsec_(monotonic_now());
+  }
+
+  // the spin reads CLOCK_MONOTONIC and the tsc once and then counts raw
+  // ticks for the remainder, extrapolated tsc time is never compared with
+  // CLOCK_MONOTONIC.
+  t_void t_periodic::spin_until_() const noexcept {
+#if (defined(__x86_64__))
+    auto rate = get_tsc_params().rate;
+    if (rate) {
+      auto start  = get(get_ticks());
+      auto remain = deadline_ - now_();
+      if (remain > 0) {
+        auto ticks = static_cast<named::t_uint64>(
+          (static_cast<unsigned __int128>(remain) << t_tsc_params::SHIFT) /
+            rate);
+        while (get(get_ticks()) - start < ticks)
+          __builtin_ia32_pause();
+      }
+      return;
+    }
+#endif
+    while (now_() < deadline_) {
+#if (defined(__x86_64__))
+      __builtin_ia32_pause();
+#endif
+    }
+  }
+
+  named::t_n t_periodic::wait() noexcept {
+    named::t_n_ missed = 0;
+    auto now = now_();
+    if (now >= deadline_) {
+      missed     = (now - deadline_)/period_ + 1;
+      deadline_ += missed*period_;
+      overruns_ += missed;
+    }
+
+    if (deadline_ - now > spin_) {
+      auto spec = to_(deadline_ - spin_);
+      while (get(call_clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, spec))
+               == EINTR);
+    }
+    spin_until_();
+
+    jitter_.record(t_nsec(now_() - deadline_));
+    deadline_ += period_;
+    ++cycles_;
+    return named::t_n{missed};
+  }
+
+  t_void t_periodic::reset_stats() noexcept {
+    cycles_   = 0;
+    overruns_ = 0;
+    jitter_.reset();
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if (defined(__x86_64__))
+  namespace
+  {
+    struct t_tsc_sample_ {
+      named::t_uint64 ticks;
+      named::t_int64  nsec;
+    };
+
+    // the clock read bracketed by the tightest pair of tsc reads
+    t_errn sample_tsc_(t_tsc_sample_& sample) noexcept {
+      named::t_uint64 best = ~named::t_uint64{0};
+      for (int ix = 0; ix < 8; ++ix) {
+        ::timespec spec;
+        auto before = get(get_ticks_ordered());
+        auto errn   = call_clock_gettime_monotonic(spec);
+        auto after  = get(get_ticks_serialized());
+        if (errn == INVALID)
+          return errn;
+        if (after - before < best) {
+          best         = after - before;
+          sample.ticks = before + best/2;
+          sample.nsec  = spec.tv_sec*1000000000LL + spec.tv_nsec;
+        }
+      }
+      return t_errn{0};
+    }
+  }
+
+  namespace
+  {
+    // the first sample of the calibration, the rate is measured from it.
+    // only touched with the seqlock held.
+    t_tsc_sample_ tsc_base_ = {0, 0};
+
+    // held by the one thread that samples for a new anchor
+    std::atomic<t_bool> tsc_renewing_{false};
+
+    t_bool lock_tsc_(t_bool wait) noexcept {
+      auto seq = tsc_seq_.load(std::memory_order_relaxed);
+      for (;;) {
+        if (seq & 1) {
+          if (!wait)
+            return false;
+          __builtin_ia32_pause();
+          seq = tsc_seq_.load(std::memory_order_relaxed);
+        } else if (tsc_seq_.compare_exchange_weak(seq, seq + 1,
+                                                  std::memory_order_acquire,
+                                                  std::memory_order_relaxed))
+          break;
+      }
+      std::atomic_thread_fence(std::memory_order_release);
+      return true;
+    }
+
+    t_void unlock_tsc_(const t_tsc_params& params) noexcept {
+      __atomic_store_n(&tsc_params_.hz,    params.hz,    __ATOMIC_RELAXED);
+      __atomic_store_n(&tsc_params_.mult,  params.mult,  __ATOMIC_RELAXED);
+      __atomic_store_n(&tsc_params_.rate,  params.rate,  __ATOMIC_RELAXED);
+      __atomic_store_n(&tsc_params_.ticks, params.ticks, __ATOMIC_RELAXED);
+      __atomic_store_n(&tsc_params_.nsec,  params.nsec,  __ATOMIC_RELAXED);
+      __atomic_store_n(&tsc_params_.renew, params.renew, __ATOMIC_RELAXED);
+      tsc_seq_.fetch_add(1, std::memory_order_release);
+    }
+
+    // the rate comes from tsc_base_ to sample. the anchor continues the
+    // current line at sample and its rate is slewed by the distance to
+    // CLOCK_MONOTONIC, so that the two meet at the next anchor.
+    t_tsc_params make_anchor_(const t_tsc_sample_& sample) noexcept {
+      using t_u128_ = unsigned __int128;
+      auto ticks = sample.ticks - tsc_base_.ticks;
+      auto nsec  = static_cast<named::t_uint64>(sample.nsec - tsc_base_.nsec);
+
+      named::t_int64 line = sample.nsec;
+      if (tsc_params_.mult) {
+        auto delta = static_cast<named::t_int64>(sample.ticks -
+                                                 tsc_params_.ticks);
+        line = tsc_params_.nsec + static_cast<named::t_int64>(
+          (static_cast<__int128>(delta) * tsc_params_.mult) >>
+            t_tsc_params::SHIFT);
+      }
+      auto offset = sample.nsec - line;
+      if (offset > t_tsc_params::STEP_NSEC ||
+          offset < -t_tsc_params::STEP_NSEC) {
+        line   = sample.nsec;
+        offset = 0;
+      }
+
+      t_tsc_params params;
+      params.hz    = static_cast<named::t_uint64>(
+        t_u128_(ticks) * 1000000000 / nsec);
+      params.renew = static_cast<named::t_uint64>(
+        t_u128_(ticks) * t_tsc_params::ANCHOR_NSEC / nsec);
+      params.mult  = static_cast<named::t_uint64>(
+        (t_u128_(t_tsc_params::ANCHOR_NSEC + offset) << t_tsc_params::SHIFT) /
+          params.renew);
+      params.rate  = static_cast<named::t_uint64>(
+        (t_u128_(nsec) << t_tsc_params::SHIFT) / ticks);
+      params.ticks = sample.ticks;
+      params.nsec  = line;
+      return params;
+    }
+  }
+
+  t_bool has_invariant_tsc() noexcept {
+    unsigned int a, b, c, d;
+    return __get_cpuid(0x80000007, &a, &b, &c, &d) && (d & (1 << 8));
+  }
+
+  t_errn calibrate_tsc(t_msec msec) noexcept {
+    t_tsc_sample_ begin, end;
+    auto errn = sample_tsc_(begin);
+    if (errn == VALID) {
+      auto spec = to_(msec);
+      do
+        errn = call_clock_nanosleep(CLOCK_MONOTONIC, 0, spec);
+      while (get(errn) == EINTR);
+    }
+    if (errn == VALID)
+      errn = sample_tsc_(end);
+    if (errn == VALID) {
+      if (end.ticks != begin.ticks && end.nsec > begin.nsec) {
+        lock_tsc_(true);
+        tsc_base_ = begin;
+        unlock_tsc_(make_anchor_(end));
+      } else
+        errn = t_errn{-1};
+    }
+    return errn;
+  }
+
+  t_void calibrate_tsc(t_err err, t_msec msec) noexcept {
+    ERR_GUARD(err) {
+      if (calibrate_tsc(msec) == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_void init_tsc_() noexcept {
+    static const t_errn errn = calibrate_tsc(t_msec{10});
+    static_cast<t_void>(errn);
+  }
+
+  // the reader that loses the race keeps converting with the old anchor and
+  // does not sample. the winner samples before it takes the seqlock, so
+  // readers are not held up by the clock reads.
+  t_void anchor_tsc_() noexcept {
+    if (tsc_renewing_.load(std::memory_order_relaxed) ||
+        tsc_renewing_.exchange(true, std::memory_order_acquire))
+      return;
+    auto params = get_tsc_params();
+    if (get(get_ticks()) - params.ticks > params.renew) {
+      t_tsc_sample_ sample;
+      if (sample_tsc_(sample) == VALID) {
+        lock_tsc_(true);
+        unlock_tsc_(make_anchor_(sample));
+      }
+    }
+    tsc_renewing_.store(false, std::memory_order_release);
+  }
+#endif
 }
 }
 }
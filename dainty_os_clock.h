@@ -27,6 +27,7 @@
 #ifndef _DAINTY_OS_CLOCK_H_
 #define _DAINTY_OS_CLOCK_H_
 
+#include <stdint.h>
 #include "dainty_os_call.h"
 
 namespace dainty
@@ -77,9 +78,10 @@ namespace clock
     constexpr T to() const noexcept;
 
   private:
-    friend constexpr       ::timespec& to_(t_time&) noexcept;
-    friend constexpr const ::timespec& to_(const t_time&) noexcept;
-    ::timespec spec_;
+    friend constexpr ::timespec to_(const t_time&) noexcept;
+    friend constexpr t_time&    to_(t_time&, const ::timespec&) noexcept;
+    friend constexpr named::t_int64 get_nsec_(const t_time&) noexcept;
+    named::t_int64 nsec_;
   };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -101,6 +103,71 @@ namespace clock
   t_time realtime_now ();
   t_time realtime_now (t_err);
 
+  // last tick of the kernel, a few ms behind but without a tsc read
+  t_time monotonic_coarse_now();
+  t_time monotonic_coarse_now(t_err);
+  t_time realtime_coarse_now ();
+  t_time realtime_coarse_now (t_err);
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // a CLOCK_MONOTONIC timestamp that readers get with a single load. an
+  // event loop calls tick() once per iteration, or start() runs a thread
+  // that refreshes it every period. readers see time stand still between
+  // refreshes, so only use it where that accuracy is good enough. the
+  // cached value never goes backwards: tick_coarse() after tick() may read
+  // an earlier time, and then it keeps and returns the later value. only
+  // one start() succeeds until stop().
+  class t_cached_now {
+  public:
+     t_cached_now() noexcept;
+    ~t_cached_now();
+
+    t_cached_now(const t_cached_now&)            = delete;
+    t_cached_now(t_cached_now&&)                 = delete;
+    t_cached_now& operator=(const t_cached_now&) = delete;
+    t_cached_now& operator=(t_cached_now&&)      = delete;
+
+    t_time get() const noexcept;
+
+    t_time tick()        noexcept;
+    t_time tick_coarse() noexcept;
+
+    t_errn start(       t_time period) noexcept;
+    t_void start(t_err, t_time period) noexcept;
+    t_void stop() noexcept;
+
+  private:
+    t_time store_(t_time) noexcept;
+    static p_void run_(p_void) noexcept;
+
+    std::atomic<named::t_int64> nsec_{0};
+    std::atomic<named::t_int64> period_{0};
+    t_pthread                   thread_;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // absolute CLOCK_MONOTONIC point in time. it is computed once from a
+  // relative timeout and can be handed to every retry of a timed wait
+  // without extending the original budget.
+  class t_deadline {
+  public:
+    enum t_absolute_tag_ { ABSOLUTE };
+
+    explicit t_deadline(t_time) noexcept;
+    t_deadline(t_err, t_time) noexcept;
+    constexpr t_deadline(t_absolute_tag_, t_time) noexcept;
+
+    constexpr t_time get_time() const noexcept;
+
+    t_bool is_expired()    const noexcept;
+    t_time get_remaining() const noexcept;
+
+  private:
+    t_time time_;
+  };
+
 ///////////////////////////////////////////////////////////////////////////////
 
   inline t_ticks get_ticks()
@@ -132,38 +199,235 @@ namespace clock
 
 ///////////////////////////////////////////////////////////////////////////////
 
-  constexpr ::timespec& to_(t_time& time) noexcept {
-    return time.spec_;
+#if (defined(__x86_64__))
+  // the time stamp counter as a clock on the CLOCK_MONOTONIC scale. ticks
+  // convert to nanoseconds with a fixed point multiply and shift from an
+  // anchor, a pair of tsc and CLOCK_MONOTONIC reads. the rate is calibrated
+  // on first use. a conversion that finds the anchor older than ANCHOR_NSEC
+  // renews it: the new anchor continues the old line and its rate is slewed
+  // to meet CLOCK_MONOTONIC at the next one, so the two never drift more
+  // than a slew period apart. they are stepped together only when more than
+  // STEP_NSEC apart. durations convert with the measured rate, never the
+  // slewed one. the result is only trustworthy with an invariant tsc, one
+  // that ticks at a constant rate in every p-state and c-state.
+  struct t_tsc_params {
+    constexpr static named::t_uint32 SHIFT       = 32;
+    constexpr static named::t_int64  ANCHOR_NSEC = 1000000000;
+    constexpr static named::t_int64  STEP_NSEC   = 1000000;
+
+    named::t_uint64 hz    = 0;
+    named::t_uint64 mult  = 0; // nsec = (ticks * mult) >> SHIFT, slewed
+    named::t_uint64 rate  = 0; // as mult, measured
+    named::t_uint64 ticks = 0; // tsc at the anchor
+    named::t_int64  nsec  = 0; // CLOCK_MONOTONIC at the anchor
+    named::t_uint64 renew = 0; // ANCHOR_NSEC in ticks
+  };
+
+  // written under the seqlock tsc_seq_, odd while written and 0 until the
+  // first calibration. read them with get_tsc_params().
+  inline t_tsc_params                 tsc_params_;
+  inline std::atomic<named::t_uint32> tsc_seq_{0};
+
+  t_bool has_invariant_tsc() noexcept;
+
+  // measure the tsc rate over the given time. it happens by itself with
+  // 10ms on first use, call it early to keep that out of a hot path.
+  t_errn calibrate_tsc(       t_msec) noexcept;
+  t_void calibrate_tsc(t_err, t_msec) noexcept;
+
+  t_void init_tsc_()   noexcept;
+  t_void anchor_tsc_() noexcept;
+
+  inline
+  t_tsc_params get_tsc_params() noexcept {
+    t_tsc_params params;
+    for (;;) {
+      auto seq = tsc_seq_.load(std::memory_order_acquire);
+      if (!seq) {
+        init_tsc_();
+        if (!tsc_seq_.load(std::memory_order_acquire))
+          return params;
+      } else if (seq & 1)
+        __builtin_ia32_pause();
+      else {
+        params.hz    = __atomic_load_n(&tsc_params_.hz,    __ATOMIC_RELAXED);
+        params.mult  = __atomic_load_n(&tsc_params_.mult,  __ATOMIC_RELAXED);
+        params.rate  = __atomic_load_n(&tsc_params_.rate,  __ATOMIC_RELAXED);
+        params.ticks = __atomic_load_n(&tsc_params_.ticks, __ATOMIC_RELAXED);
+        params.nsec  = __atomic_load_n(&tsc_params_.nsec,  __ATOMIC_RELAXED);
+        params.renew = __atomic_load_n(&tsc_params_.renew, __ATOMIC_RELAXED);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (tsc_seq_.load(std::memory_order_relaxed) == seq)
+          return params;
+      }
+    }
+  }
+
+  // get_ticks() may execute before earlier instructions complete and later
+  // ones may start before it. ordered waits for earlier instructions, use
+  // it to start a measurement. serialized also keeps later instructions
+  // back, use it to end one.
+  inline
+  t_ticks get_ticks_ordered() noexcept {
+    unsigned int a, d;
+    asm volatile("lfence\n\trdtsc" : "=a" (a), "=d" (d) :: "memory");
+    return t_ticks{(((named::t_uint64)d) << 32) | a};
+  }
+
+  inline
+  t_ticks get_ticks_serialized() noexcept {
+    unsigned int a, d, c;
+    asm volatile("rdtscp\n\tlfence" : "=a" (a), "=d" (d), "=c" (c)
+                                      :: "memory");
+    return t_ticks{(((named::t_uint64)d) << 32) | a};
+  }
+
+  // for durations, ticks is a difference of two reads
+  inline
+  t_nsec tsc_to_nsec(t_ticks ticks) noexcept {
+    auto rate = __atomic_load_n(&tsc_params_.rate, __ATOMIC_RELAXED);
+    if (!rate)
+      rate = get_tsc_params().rate;
+    return t_nsec(static_cast<named::t_int64>(
+      (static_cast<unsigned __int128>(get(ticks)) * rate) >>
+        t_tsc_params::SHIFT));
+  }
+
+  inline
+  t_time tsc_to_time(t_ticks ticks) noexcept;
+
+  // a tsc read converted to CLOCK_MONOTONIC
+  inline
+  t_time tsc_to_monotonic(t_ticks ticks) noexcept;
+
+  inline
+  t_time tsc_now() noexcept;
+
+  struct t_tsc_scope {
+    t_time& time;
+    t_ticks start;
+
+    inline
+    t_tsc_scope(t_time& t) noexcept : time(t), start(get_ticks_ordered()) { }
+    inline
+    ~t_tsc_scope() noexcept;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+#endif
+
+  // t_time is a signed 64 bit count of nanoseconds, +-292 years. it is
+  // only turned into a ::timespec where a syscall needs one. arithmetic
+  // saturates instead of wrapping, or throws when
+  // DAINTY_OS_CLOCK_OVERFLOW_ASSERT is defined.
+  constexpr named::t_int64 NSEC_MAX_ = INT64_MAX;
+  constexpr named::t_int64 NSEC_MIN_ = INT64_MIN;
+
+  constexpr named::t_int64 saturate_(named::t_int64 value,
+                                     named::t_int64 scale) noexcept {
+    named::t_int64 nsec = 0;
+    if (__builtin_mul_overflow(value, scale, &nsec))
+      return value < 0 ? NSEC_MIN_ : NSEC_MAX_;
+    return nsec;
+  }
+
+  constexpr named::t_int64 to_nsec_(t_nsec nsec) noexcept {
+    return get(nsec);
+  }
+
+  constexpr named::t_int64 to_nsec_(t_usec usec) noexcept {
+    return saturate_(get(usec), 1000);
+  }
+
+  constexpr named::t_int64 to_nsec_(t_msec msec) noexcept {
+    return saturate_(get(msec), 1000000);
+  }
+
+  constexpr named::t_int64 to_nsec_(t_sec sec) noexcept {
+    return saturate_(get(sec), 1000000000);
+  }
+
+  constexpr named::t_int64 to_nsec_(t_min min) noexcept {
+    return saturate_(get(min), 60000000000);
+  }
+
+  constexpr named::t_int64 get_nsec_(const t_time& time) noexcept {
+    return time.nsec_;
+  }
+
+  constexpr named::t_int64 to_nsec_(const t_time& time) noexcept {
+    return get_nsec_(time);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  constexpr ::timespec to_(named::t_int64 nsec) noexcept {
+    ::timespec spec{::time_t(nsec/1000000000), named::t_long(nsec%1000000000)};
+    if (spec.tv_nsec < 0) {
+      spec.tv_sec  -= 1;
+      spec.tv_nsec += 1000000000;
+    }
+    return spec;
   }
 
-  constexpr const ::timespec& to_(const t_time& time) noexcept {
-    return time.spec_;
+  constexpr ::timespec to_(const t_time& time) noexcept {
+    return to_(time.nsec_);
+  }
+
+  constexpr t_time& to_(t_time& time, const ::timespec& spec) noexcept {
+    time.nsec_ = saturate_(spec.tv_sec, 1000000000);
+    if (__builtin_add_overflow(time.nsec_, spec.tv_nsec, &time.nsec_))
+      time.nsec_ = NSEC_MAX_;
+    return time;
   }
 
   constexpr ::timespec to_(t_nsec nsec) noexcept {
-    return { ::time_t(get(nsec)/1000000000),
-             named::t_long(get(nsec)%1000000000)}; // narrow - XXX
+    return to_(to_nsec_(nsec));
   }
 
   constexpr ::timespec to_(t_usec usec) noexcept {
-    return { ::time_t(get(usec)/1000000),
-             named::t_long(get(usec)%1000000)}; // narrow - XXX
+    return to_(to_nsec_(usec));
   }
 
   constexpr ::timespec to_(t_msec msec) noexcept {
-    return { get(msec)/1000, get(msec)%1000}; // narrow
+    return to_(to_nsec_(msec));
   }
 
   constexpr ::timespec to_(t_sec sec) noexcept {
-    return {get(sec), 0}; // narrow
+    return to_(to_nsec_(sec));
   }
 
   constexpr ::timespec to_(t_min min) noexcept {
-    return { get(min)*60, 0}; // narrow
+    return to_(to_nsec_(min));
   }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+  constexpr t_nsec& to_(t_nsec& nsec, named::t_int64 value) noexcept {
+    set(nsec) = value;
+    return nsec;
+  }
+
+  constexpr t_usec& to_(t_usec& usec, named::t_int64 value) noexcept {
+    set(usec) = value/1000;
+    return usec;
+  }
+
+  constexpr t_msec& to_(t_msec& msec, named::t_int64 value) noexcept {
+    set(msec) = value/1000000;
+    return msec;
+  }
+
+  constexpr t_sec& to_(t_sec& sec, named::t_int64 value) noexcept {
+    set(sec) = value/1000000000;
+    return sec;
+  }
+
+  constexpr t_min& to_(t_min& min, named::t_int64 value) noexcept {
+    set(min) = value/60000000000;
+    return min;
+  }
+
   constexpr t_nsec& to_(t_nsec& nsec, const ::timespec& spec) noexcept {
     set(nsec) = spec.tv_nsec + (1000000000*spec.tv_sec);
     return nsec;
@@ -191,81 +455,153 @@ namespace clock
 
 ///////////////////////////////////////////////////////////////////////////////
 
-  constexpr t_bool overflow_(const t_time&,
-                             const ::timespec&) noexcept {
-    return true; // impl later - XXX
+  constexpr t_bool overflow_(named::t_int64 nsec,
+                             named::t_int64 value) noexcept {
+    named::t_int64 sum = 0;
+    return __builtin_add_overflow(nsec, value, &sum);
   }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-  constexpr t_bool underflow_(const t_time&,
-                              const ::timespec&) noexcept {
-    return true; // impl later - XXX
+  constexpr t_bool underflow_(named::t_int64 nsec,
+                              named::t_int64 value) noexcept {
+    named::t_int64 diff = 0;
+    return __builtin_sub_overflow(nsec, value, &diff);
   }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-  constexpr t_void add_(const t_time& time, ::timespec& spec) noexcept {
+  constexpr t_void add_(named::t_int64 value, named::t_int64& nsec) noexcept {
+    if (__builtin_add_overflow(nsec, value, &nsec)) {
 #ifdef DAINTY_OS_CLOCK_OVERFLOW_ASSERT
-    if (overflow_(time, spec)) // impl later - XXX
       throw 1;
 #endif
-    spec.tv_sec  += to_(time).tv_sec;
-    spec.tv_nsec += to_(time).tv_nsec;
-    spec.tv_sec  += spec.tv_nsec/1000000000;
-    spec.tv_nsec  = spec.tv_nsec%1000000000;
+      nsec = value < 0 ? NSEC_MIN_ : NSEC_MAX_;
+    }
   }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-  constexpr t_void minus_(const t_time& time, ::timespec& spec) noexcept {
+  constexpr t_void minus_(named::t_int64 value, named::t_int64& nsec) noexcept {
+    if (__builtin_sub_overflow(nsec, value, &nsec)) {
 #ifdef DAINTY_OS_CLOCK_OVERFLOW_ASSERT
-    if (underflow_(time, spec)) // impl later - XXX
       throw 1;
 #endif
-    spec.tv_sec -= to_(time).tv_sec;
-    if (to_(time).tv_nsec > spec.tv_nsec) {
-      spec.tv_sec  -= 1;
-      spec.tv_nsec += (1000000000 - to_(time).tv_nsec);
-    } else
-      spec.tv_nsec -= to_(time).tv_nsec;
+      nsec = value < 0 ? NSEC_MAX_ : NSEC_MIN_;
+    }
   }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-  constexpr t_time::t_time() noexcept : spec_{to_(t_nsec{0})} {
+  constexpr t_time::t_time() noexcept : nsec_{0} {
   }
 
   template<typename T, typename>
-  constexpr t_time::t_time(T value) noexcept : spec_{to_(value)} {
+  constexpr t_time::t_time(T value) noexcept : nsec_{to_nsec_(value)} {
   }
 
   template<typename T, typename>
   constexpr t_time& t_time::operator+=(T value) noexcept {
-    add_(t_time{value}, spec_);
+    add_(to_nsec_(value), nsec_);
     return *this;
   }
 
   template<typename T, typename>
   constexpr t_time& t_time::operator-=(T value) noexcept {
-    minus_(t_time{value}, spec_);
+    minus_(to_nsec_(value), nsec_);
     return *this;
   }
 
   template<typename T, typename>
   constexpr T t_time::to() const noexcept {
     T value{0};
-    return to_(value, spec_);
+    return to_(value, nsec_);
   }
 
   template<typename T, typename>
   constexpr t_bool t_time::test_overflow(T value) noexcept {
-    return overflow_(t_time{value}, spec_);
+    return overflow_(nsec_, to_nsec_(value));
   }
 
   template<typename T, typename>
   constexpr t_bool t_time::test_underflow(T value) noexcept {
-    return underflow_(t_time{value}, spec_);
+    return underflow_(nsec_, to_nsec_(value));
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  constexpr t_bool operator==(const t_time& lh, const t_time& rh) noexcept {
+    return get_nsec_(lh) == get_nsec_(rh);
+  }
+
+  constexpr t_bool operator!=(const t_time& lh, const t_time& rh) noexcept {
+    return !(lh == rh);
+  }
+
+  constexpr t_bool operator<(const t_time& lh, const t_time& rh) noexcept {
+    return get_nsec_(lh) < get_nsec_(rh);
+  }
+
+  constexpr t_bool operator>(const t_time& lh, const t_time& rh) noexcept {
+    return rh < lh;
+  }
+
+  constexpr t_bool operator<=(const t_time& lh, const t_time& rh) noexcept {
+    return !(rh < lh);
+  }
+
+  constexpr t_bool operator>=(const t_time& lh, const t_time& rh) noexcept {
+    return !(lh < rh);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  constexpr t_deadline::t_deadline(t_absolute_tag_, t_time time) noexcept
+    : time_{time} {
+  }
+
+  constexpr t_time t_deadline::get_time() const noexcept {
+    return time_;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if (defined(__x86_64__))
+  inline
+  t_time tsc_to_time(t_ticks ticks) noexcept {
+    return {tsc_to_nsec(ticks)};
+  }
+
+  inline
+  t_time tsc_to_monotonic(t_ticks ticks) noexcept {
+    auto params = get_tsc_params();
+    auto delta  = static_cast<named::t_int64>(get(ticks) - params.ticks);
+    if (params.renew && delta > static_cast<named::t_int64>(params.renew)) {
+      anchor_tsc_();
+      params = get_tsc_params();
+      delta  = static_cast<named::t_int64>(get(ticks) - params.ticks);
+    }
+    auto nsec = static_cast<named::t_int64>(
+      (static_cast<__int128>(delta) * params.mult) >> t_tsc_params::SHIFT);
+    return {t_nsec(params.nsec + nsec)};
+  }
+
+  inline
+  t_time tsc_now() noexcept {
+    return tsc_to_monotonic(get_ticks());
+  }
+
+  inline
+  t_tsc_scope::~t_tsc_scope() noexcept {
+    time = tsc_to_time(t_ticks(get(get_ticks_serialized()) - get(start)));
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+#endif
+
+  inline
+  t_time t_cached_now::get() const noexcept {
+    return {t_nsec(nsec_.load(std::memory_order_relaxed))};
   }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -346,6 +682,289 @@ namespace clock
     t_time last_;
   };
 
+///////////////////////////////////////////////////////////////////////////////
+
+  // latency histogram in nanoseconds with the HdrHistogram layout: every
+  // power of two range is split into enough linear sub buckets to keep
+  // DIGITS significant decimal digits. values above MAX_NSEC count as
+  // MAX_NSEC, negative ones as 0.
+  //
+  // record() is O(1), allocation free and wait free but it has a single
+  // writer: keep a histogram per thread and merge() them into another one
+  // to query. counts are written and read with relaxed atomics, so a merge
+  // that runs while a thread records sees a slightly stale histogram but
+  // never a torn count.
+  template<named::t_n_ DIGITS = 2, named::t_uint64 MAX_NSEC = 60000000000>
+  class t_histogram {
+    static_assert(DIGITS >= 1 && DIGITS <= 5, "DIGITS must be 1 to 5");
+  public:
+    using t_count = named::t_uint64;
+
+    t_void record(t_time) noexcept;
+    t_void record(t_nsec) noexcept;
+#if (defined(__x86_64__))
+    // a difference of two tsc reads
+    t_void record(t_ticks) noexcept;
+#endif
+
+    t_void merge(const t_histogram&) noexcept;
+    t_void reset() noexcept;
+
+    t_count get_count() const noexcept;
+    t_time  get_min()   const noexcept;
+    t_time  get_max()   const noexcept;
+    t_time  get_mean()  const noexcept;
+
+    // highest value equivalent to the one at percent, 0 to 100
+    t_time  get_percentile(double percent) const noexcept;
+
+  private:
+    using t_value_ = named::t_uint64;
+
+    constexpr static named::t_n_ log2_ceil_(t_value_ value) {
+      named::t_n_ n = 0;
+      while ((t_value_{1} << n) < value)
+        ++n;
+      return n;
+    }
+
+    constexpr static t_value_ pow10_(named::t_n_ n) {
+      return n ? 10 * pow10_(n - 1) : 1;
+    }
+
+    constexpr static named::t_n_ buckets_(named::t_n_ sub_count) {
+      named::t_n_ n = 1;
+      while ((t_value_{sub_count} << (n - 1)) <= MAX_NSEC)
+        ++n;
+      return n;
+    }
+
+    enum : named::t_n_ {
+      SUB_MAG_    = log2_ceil_(2 * pow10_(DIGITS)),
+      SUB_COUNT_  = named::t_n_{1} << SUB_MAG_,
+      HALF_MAG_   = SUB_MAG_ - 1,
+      HALF_COUNT_ = SUB_COUNT_ / 2,
+      BUCKETS_    = buckets_(SUB_COUNT_),
+      COUNTS_     = (BUCKETS_ + 1) * HALF_COUNT_,
+      LZ_BASE_    = 64 - HALF_MAG_ - 1
+    };
+
+    static named::t_n_ index_(t_value_) noexcept;
+    static t_value_    highest_(named::t_n_ index) noexcept;
+
+    static t_value_ load_(const t_value_& value) noexcept {
+      return __atomic_load_n(&value, __ATOMIC_RELAXED);
+    }
+
+    static t_void store_(t_value_& value, t_value_ n) noexcept {
+      __atomic_store_n(&value, n, __ATOMIC_RELAXED);
+    }
+
+    t_value_ counts_[COUNTS_] = {};
+    t_value_ total_           = 0;
+    t_value_ sum_             = 0;
+    t_value_ min_             = ~t_value_{0};
+    t_value_ max_             = 0;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<named::t_n_ D, named::t_uint64 M>
+  inline
+  named::t_n_ t_histogram<D, M>::index_(t_value_ value) noexcept {
+    named::t_n_ bucket = LZ_BASE_ -
+      __builtin_clzll(value | (SUB_COUNT_ - 1));
+    named::t_n_ sub    = value >> bucket;
+    return ((bucket + 1) << HALF_MAG_) + sub - HALF_COUNT_;
+  }
+
+  template<named::t_n_ D, named::t_uint64 M>
+  inline
+  typename t_histogram<D, M>::t_value_
+      t_histogram<D, M>::highest_(named::t_n_ index) noexcept {
+    named::t_n_ bucket = 0;
+    named::t_n_ sub    = index;
+    if (index >= SUB_COUNT_) {
+      bucket = (index >> HALF_MAG_) - 1;
+      sub    = (index & (HALF_COUNT_ - 1)) + HALF_COUNT_;
+    }
+    return (t_value_{sub} << bucket) + (t_value_{1} << bucket) - 1;
+  }
+
+  template<named::t_n_ D, named::t_uint64 M>
+  inline
+  t_void t_histogram<D, M>::record(t_nsec nsec) noexcept {
+    t_value_ value = get(nsec) < 0 ? 0 :
+                     static_cast<t_value_>(get(nsec)) > M ? M :
+                     static_cast<t_value_>(get(nsec));
+    auto& count = counts_[index_(value)];
+    store_(count,  load_(count) + 1);
+    store_(total_, load_(total_) + 1);
+    store_(sum_,   load_(sum_) + value);
+    if (value < load_(min_))
+      store_(min_, value);
+    if (value > load_(max_))
+      store_(max_, value);
+  }
+
+  template<named::t_n_ D, named::t_uint64 M>
+  inline
+  t_void t_histogram<D, M>::record(t_time time) noexcept {
+    record(time.to<t_nsec>());
+  }
+
+#if (defined(__x86_64__))
+  template<named::t_n_ D, named::t_uint64 M>
+  inline
+  t_void t_histogram<D, M>::record(t_ticks ticks) noexcept {
+    record(tsc_to_nsec(ticks));
+  }
+#endif
+
+  template<named::t_n_ D, named::t_uint64 M>
+  inline
+  t_void t_histogram<D, M>::merge(const t_histogram& other) noexcept {
+    for (named::t_n_ ix = 0; ix < COUNTS_; ++ix)
+      if (auto n = load_(other.counts_[ix]))
+        store_(counts_[ix], load_(counts_[ix]) + n);
+    store_(total_, load_(total_) + load_(other.total_));
+    store_(sum_,   load_(sum_)   + load_(other.sum_));
+    if (load_(other.min_) < load_(min_))
+      store_(min_, load_(other.min_));
+    if (load_(other.max_) > load_(max_))
+      store_(max_, load_(other.max_));
+  }
+
+  template<named::t_n_ D, named::t_uint64 M>
+  inline
+  t_void t_histogram<D, M>::reset() noexcept {
+    for (auto& count : counts_)
+      store_(count, 0);
+    store_(total_, 0);
+    store_(sum_,   0);
+    store_(min_,   ~t_value_{0});
+    store_(max_,   0);
+  }
+
+  template<named::t_n_ D, named::t_uint64 M>
+  inline
+  typename t_histogram<D, M>::t_count
+      t_histogram<D, M>::get_count() const noexcept {
+    return load_(total_);
+  }
+
+  template<named::t_n_ D, named::t_uint64 M>
+  inline
+  t_time t_histogram<D, M>::get_min() const noexcept {
+    return load_(total_) ? t_time{t_nsec(load_(min_))} : t_time{};
+  }
+
+  template<named::t_n_ D, named::t_uint64 M>
+  inline
+  t_time t_histogram<D, M>::get_max() const noexcept {
+    return t_time{t_nsec(load_(max_))};
+  }
+
+  template<named::t_n_ D, named::t_uint64 M>
+  inline
+  t_time t_histogram<D, M>::get_mean() const noexcept {
+    auto total = load_(total_);
+    return total ? t_time{t_nsec(load_(sum_) / total)} : t_time{};
+  }
+
+  template<named::t_n_ D, named::t_uint64 M>
+  inline
+  t_time t_histogram<D, M>::get_percentile(double percent) const noexcept {
+    t_value_ total = 0;
+    for (named::t_n_ ix = 0; ix < COUNTS_; ++ix)
+      total += load_(counts_[ix]);
+    if (!total)
+      return {};
+    percent = percent < 0.0 ? 0.0 : percent > 100.0 ? 100.0 : percent;
+    t_value_ target = static_cast<t_value_>(percent / 100.0 * total + 0.5);
+    if (!target)
+      target = 1;
+    t_value_ seen = 0;
+    for (named::t_n_ ix = 0; ix < COUNTS_; ++ix) {
+      seen += load_(counts_[ix]);
+      if (seen >= target) {
+        t_value_ value = highest_(ix), max = load_(max_);
+        return t_time{t_nsec(value < max ? value : max)};
+      }
+    }
+    return get_max();
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // cyclic execution on absolute CLOCK_MONOTONIC deadlines, a late wakeup
+  // does not move the ones after it. wait() sleeps with TIMER_ABSTIME until
+  // spin before the deadline and spins on raw tsc ticks for the rest, which
+  // trades cpu for wakeup jitter. spin should cover the timer slack, 50us
+  // unless changed with PR_SET_TIMERSLACK. a deadline that passed before
+  // wait() is called is an overrun and is skipped to keep the phase. how
+  // late every wakeup was, on CLOCK_MONOTONIC, is kept in a histogram.
+  class t_periodic {
+  public:
+    using t_count  = named::t_uint64;
+    using t_jitter = t_histogram<2, 1000000000>;
+
+    t_periodic(t_time period, t_time spin = t_time{t_usec{50}}) noexcept;
+
+    // the first deadline is one period from now. the tsc calibration, about
+    // 10ms the first time in a process, is done here and not in wait().
+    t_void start() noexcept;
+
+    // wait for the next deadline, returns the deadlines that were missed
+    named::t_n wait() noexcept;
+
+    t_time get_period()   const noexcept;
+    t_time get_deadline() const noexcept;
+
+    t_count         get_cycles()   const noexcept;
+    t_count         get_overruns() const noexcept;
+    const t_jitter& get_jitter()   const noexcept;
+    t_void          reset_stats()        noexcept;
+
+  private:
+    named::t_int64 now_() const noexcept;
+    t_void         spin_until_() const noexcept;
+
+    named::t_int64 period_;
+    named::t_int64 spin_;
+    named::t_int64 deadline_ = 0;
+    t_count        cycles_   = 0;
+    t_count        overruns_ = 0;
+    t_jitter       jitter_;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_time t_periodic::get_period() const noexcept {
+    return {t_nsec(period_)};
+  }
+
+  inline
+  t_time t_periodic::get_deadline() const noexcept {
+    return {t_nsec(deadline_)};
+  }
+
+  inline
+  t_periodic::t_count t_periodic::get_cycles() const noexcept {
+    return cycles_;
+  }
+
+  inline
+  t_periodic::t_count t_periodic::get_overruns() const noexcept {
+    return overruns_;
+  }
+
+  inline
+  const t_periodic::t_jitter& t_periodic::get_jitter() const noexcept {
+    return jitter_;
+  }
+
 ///////////////////////////////////////////////////////////////////////////////
 
 }
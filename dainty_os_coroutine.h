@@ -0,0 +1,442 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_OS_COROUTINE_H_
+#define _DAINTY_OS_COROUTINE_H_
+
+// description
+// os: operating system functionality used by dainty
+//
+//  c++20 coroutine support: awaitables for fd readiness, eventfd, timerfd
+//  and socket i/o, resumed from an epoll driven executor. optional, not
+//  included by dainty_os.h, and empty when compiled without coroutines.
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <errno.h>
+#include <coroutine>
+#include <exception>
+#include <new>
+#include "dainty_named.h"
+#include "dainty_oops.h"
+#include "dainty_os_call.h"
+#include "dainty_os_fdbased.h"
+
+namespace dainty
+{
+namespace os
+{
+namespace coroutine
+{
+  using named::p_void;
+  using named::P_void;
+  using named::t_void;
+  using named::t_bool;
+  using named::t_validity;
+  using named::t_n_;
+  using named::t_n;
+  using named::t_fd;
+  using named::VALID;
+  using named::INVALID;
+  using err::t_err;
+  using fdbased::t_epoll;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // per thread recycling pool for coroutine frames. frames up to
+  // CLASSES * CLASS_SIZE bytes are kept on size class free lists, larger
+  // ones go to operator new. memory is kept for reuse by the thread that
+  // frees it and given back when that thread exits.
+  class t_frame_pool {
+  public:
+    constexpr static t_n_ CLASS_SIZE = 64;
+    constexpr static t_n_ CLASSES    = 32;
+
+    static p_void allocate  (t_n_ size)         noexcept;
+    static t_void deallocate(p_void, t_n_ size) noexcept;
+
+  private:
+    struct t_free_ {
+      t_free_* next;
+    };
+
+    struct t_lists_ {
+      t_free_* heads[CLASSES] = {};
+      ~t_lists_();
+    };
+
+    // nullptr once the lists of the exiting thread are released, a frame
+    // freed after that goes straight to operator delete
+    static t_free_** get_list_(t_n_ ix) noexcept;
+
+    inline static thread_local t_bool released_ = false;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // detached coroutine: starts eagerly and frees its frame when it ends
+  class t_task {
+  public:
+    struct promise_type {
+      static p_void operator new(std::size_t size) noexcept {
+        return t_frame_pool::allocate(size);
+      }
+      static t_void operator delete(p_void ptr, std::size_t size) noexcept {
+        t_frame_pool::deallocate(ptr, size);
+      }
+      static t_task get_return_object_on_allocation_failure() noexcept {
+        return t_task{INVALID};
+      }
+
+      t_task              get_return_object() noexcept { return t_task{VALID}; }
+      std::suspend_never  initial_suspend()   noexcept { return {}; }
+      std::suspend_never  final_suspend()     noexcept { return {}; }
+      t_void              return_void()       noexcept { }
+      t_void              unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    operator t_validity() const noexcept { return valid_; }
+
+  private:
+    explicit t_task(t_validity valid) noexcept : valid_{valid} { }
+    t_validity valid_;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  class t_executor;
+  using r_executor = named::t_prefix<t_executor>::r_;
+
+  // suspends until the fd reports the requested events. co_await yields
+  // t_errn: VALID once ready, INVALID when the fd could not be watched.
+  class t_fd_awaiter {
+  public:
+    using t_event_mask = t_epoll::t_event_mask;
+
+    t_fd_awaiter(r_executor, t_fd, t_event_mask) noexcept;
+
+    t_bool await_ready() const noexcept { return false; }
+    t_bool await_suspend(std::coroutine_handle<>) noexcept;
+    t_errn await_resume() noexcept;
+
+  private:
+    friend class t_executor;
+    friend class t_io_awaiter;
+
+    r_executor              executor_;
+    t_fd                    fd_;
+    t_event_mask            mask_;
+    t_errn                  errn_{0};
+    std::coroutine_handle<> handle_;
+  };
+
+  // readiness then read, for eventfd and timerfd
+  template<typename F, typename V>
+  class t_read_awaiter : public t_fd_awaiter {
+  public:
+    t_read_awaiter(r_executor executor, F& fd, V& value) noexcept
+      : t_fd_awaiter{executor, fd.get_fd(), EPOLLIN}, source_{fd},
+        value_{value} {
+    }
+
+    t_errn await_resume() noexcept {
+      auto errn = t_fd_awaiter::await_resume();
+      return errn == VALID ? source_.read(value_) : errn;
+    }
+
+  private:
+    F& source_;
+    V& value_;
+  };
+
+  // non blocking socket i/o: tries the call first and only suspends on
+  // EAGAIN. co_await yields t_verify<t_n>, the bytes transferred. a
+  // spurious wakeup is reported as errn EAGAIN.
+  class t_io_awaiter {
+  public:
+    using t_event_mask = t_epoll::t_event_mask;
+
+    t_io_awaiter(r_executor, t_fd, p_void, t_n, t_bool send) noexcept;
+
+    t_bool        await_ready() noexcept;
+    t_bool        await_suspend(std::coroutine_handle<>) noexcept;
+    t_verify<t_n> await_resume() noexcept;
+
+  private:
+    t_verify<t_n> io_() noexcept;
+
+    t_fd_awaiter  wait_;
+    p_void        buf_;
+    t_n           n_;
+    t_bool        send_;
+    t_verify<t_n> result_{t_n{0}, t_errn{0}};
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // resumes coroutines from its epoll loop. one executor per thread; the
+  // coroutines it resumes run on that thread.
+  class t_executor {
+  public:
+    using t_event_mask = t_epoll::t_event_mask;
+
+     t_executor()      noexcept;
+     t_executor(t_err) noexcept;
+
+    t_executor(const t_executor&)            = delete;
+    t_executor(t_executor&&)                 = delete;
+    t_executor& operator=(const t_executor&) = delete;
+    t_executor& operator=(t_executor&&)      = delete;
+
+    operator t_validity() const noexcept;
+
+    t_n get_waiting() const noexcept;
+
+    // runs until no coroutine waits on this executor or epoll fails
+    t_errn run()      noexcept;
+    t_void run(t_err) noexcept;
+
+    t_fd_awaiter readable(t_fd) noexcept;
+    t_fd_awaiter writable(t_fd) noexcept;
+
+    t_read_awaiter<fdbased::t_eventfd, fdbased::t_eventfd::t_value>
+      read(fdbased::r_eventfd, fdbased::t_eventfd::r_value) noexcept;
+
+    t_read_awaiter<fdbased::t_timerfd, fdbased::t_timerfd::t_data>
+      read(fdbased::r_timerfd, fdbased::t_timerfd::r_data) noexcept;
+
+    t_io_awaiter recv(t_fd, p_void, t_n) noexcept;
+    t_io_awaiter send(t_fd, P_void, t_n) noexcept;
+
+  private:
+    friend class t_fd_awaiter;
+
+    t_epoll epoll_;
+    t_n_    waiting_ = 0;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_frame_pool::t_lists_::~t_lists_() {
+    for (auto& head : heads) {
+      while (head) {
+        t_free_* frame = head;
+        head = frame->next;
+        ::operator delete(frame);
+      }
+    }
+    released_ = true;
+  }
+
+  inline
+  t_frame_pool::t_free_** t_frame_pool::get_list_(t_n_ ix) noexcept {
+    if (released_)
+      return nullptr;
+    thread_local t_lists_ lists;
+    return &lists.heads[ix];
+  }
+
+  inline
+  p_void t_frame_pool::allocate(t_n_ size) noexcept {
+    t_n_ ix = (size + CLASS_SIZE - 1) / CLASS_SIZE;
+    if (ix && ix <= CLASSES) {
+      auto list = get_list_(ix - 1);
+      if (list && *list) {
+        t_free_* frame = *list;
+        *list = frame->next;
+        return frame;
+      }
+      return ::operator new(ix * CLASS_SIZE, std::nothrow);
+    }
+    return ::operator new(size, std::nothrow);
+  }
+
+  inline
+  t_void t_frame_pool::deallocate(p_void ptr, t_n_ size) noexcept {
+    t_n_ ix = (size + CLASS_SIZE - 1) / CLASS_SIZE;
+    auto list = ix && ix <= CLASSES ? get_list_(ix - 1) : nullptr;
+    if (list)
+      *list = new (ptr) t_free_{*list};
+    else
+      ::operator delete(ptr);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_fd_awaiter::t_fd_awaiter(r_executor executor, t_fd fd,
+                             t_event_mask mask) noexcept
+    : executor_(executor), fd_{fd}, mask_{mask} {
+  }
+
+  inline
+  t_bool t_fd_awaiter::await_suspend(std::coroutine_handle<> handle) noexcept {
+    handle_ = handle;
+    t_epoll::t_event_data data;
+    data.ptr = this;
+    errn_ = executor_.epoll_.add_event(fd_, mask_ | EPOLLONESHOT, data);
+    if (errn_ == INVALID)
+      return false;
+    ++executor_.waiting_;
+    return true;
+  }
+
+  inline
+  t_errn t_fd_awaiter::await_resume() noexcept {
+    if (errn_ == VALID)
+      executor_.epoll_.del_event(fd_);
+    return errn_;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_io_awaiter::t_io_awaiter(r_executor executor, t_fd fd, p_void buf, t_n n,
+                             t_bool send) noexcept
+    : wait_{executor, fd, send ? EPOLLOUT : EPOLLIN}, buf_{buf}, n_{n},
+      send_{send} {
+  }
+
+  inline
+  t_verify<t_n> t_io_awaiter::io_() noexcept {
+    return send_ ? call_send(wait_.fd_, buf_, n_, MSG_DONTWAIT)
+                 : call_recv(wait_.fd_, buf_, n_, MSG_DONTWAIT);
+  }
+
+  inline
+  t_bool t_io_awaiter::await_ready() noexcept {
+    result_ = io_();
+    return get(result_.errn) != EAGAIN && get(result_.errn) != EWOULDBLOCK;
+  }
+
+  inline
+  t_bool t_io_awaiter::await_suspend(std::coroutine_handle<> handle) noexcept {
+    return wait_.await_suspend(handle);
+  }
+
+  inline
+  t_verify<t_n> t_io_awaiter::await_resume() noexcept {
+    if (get(result_.errn) == EAGAIN || get(result_.errn) == EWOULDBLOCK) {
+      auto errn = wait_.await_resume();
+      if (errn == INVALID)
+        return {t_n{0}, errn};
+      result_ = io_();
+    }
+    return result_;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_executor::t_executor() noexcept {
+  }
+
+  inline
+  t_executor::t_executor(t_err err) noexcept : epoll_{err} {
+  }
+
+  inline
+  t_executor::operator t_validity() const noexcept {
+    return epoll_;
+  }
+
+  inline
+  t_n t_executor::get_waiting() const noexcept {
+    return t_n{waiting_};
+  }
+
+  inline
+  t_errn t_executor::run() noexcept {
+    if (epoll_ == INVALID)
+      return t_errn{-1};
+    t_epoll::t_event events[64];
+    while (waiting_) {
+      auto verify = epoll_.wait(events);
+      if (verify == VALID) {
+        for (t_n_ ix = 0; ix < get(verify.value); ++ix) {
+          auto awaiter = static_cast<t_fd_awaiter*>(events[ix].data.ptr);
+          --waiting_;
+          awaiter->handle_.resume();
+        }
+      } else if (errno != EINTR)
+        return verify.errn;
+    }
+    return t_errn{0};
+  }
+
+  inline
+  t_void t_executor::run(t_err err) noexcept {
+    ERR_GUARD(err) {
+      if (epoll_ == VALID) {
+        if (run() == INVALID)
+          err = err::E_XXX;
+      } else
+        err = err::E_INVALID_INST;
+    }
+  }
+
+  inline
+  t_fd_awaiter t_executor::readable(t_fd fd) noexcept {
+    return {*this, fd, EPOLLIN};
+  }
+
+  inline
+  t_fd_awaiter t_executor::writable(t_fd fd) noexcept {
+    return {*this, fd, EPOLLOUT};
+  }
+
+  inline
+  t_read_awaiter<fdbased::t_eventfd, fdbased::t_eventfd::t_value>
+      t_executor::read(fdbased::r_eventfd eventfd,
+                       fdbased::t_eventfd::r_value value) noexcept {
+    return {*this, eventfd, value};
+  }
+
+  inline
+  t_read_awaiter<fdbased::t_timerfd, fdbased::t_timerfd::t_data>
+      t_executor::read(fdbased::r_timerfd timerfd,
+                       fdbased::t_timerfd::r_data data) noexcept {
+    return {*this, timerfd, data};
+  }
+
+  inline
+  t_io_awaiter t_executor::recv(t_fd fd, p_void buf, t_n n) noexcept {
+    return {*this, fd, buf, n, false};
+  }
+
+  inline
+  t_io_awaiter t_executor::send(t_fd fd, P_void buf, t_n n) noexcept {
+    return {*this, fd, const_cast<p_void>(buf), n, true};
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
+#endif
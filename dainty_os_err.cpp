@@ -45,7 +45,9 @@ namespace err
       { IGNORE, P_cstr{"os::init failed"},     E_DESTROY_FAIL       },
       { IGNORE, P_cstr{"os::destroy failed"},  E_ATTR_NOT_RECURSIVE },
       { IGNORE, P_cstr{"os::not recursive"},   E_ATTR_NOT_MONOTONIC },
-      { IGNORE, P_cstr{"os::not monotonic"},   E_XXX                },
+      { IGNORE, P_cstr{"os::not monotonic"},   E_OWNER_DEAD         },
+      { IGNORE, P_cstr{"os::owner dead"},      E_NOT_RECOVERABLE    },
+      { IGNORE, P_cstr{"os::not recoverable"}, E_XXX                },
       { IGNORE, P_cstr{"os::undefined error"}, 0                    }
     };
   }
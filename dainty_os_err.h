@@ -55,6 +55,8 @@ namespace err
     E_DESTROY_FAIL,
     E_ATTR_NOT_RECURSIVE,
     E_ATTR_NOT_MONOTONIC,
+    E_OWNER_DEAD,
+    E_NOT_RECOVERABLE,
     E_XXX
   };
 
@@ -50,6 +50,7 @@ namespace fdbased
 ///////////////////////////////////////////////////////////////////////////////
 
   class t_eventfd;
+  using p_eventfd = t_prefix<t_eventfd>::p_;
   using r_eventfd = t_prefix<t_eventfd>::r_;
   using x_eventfd = t_prefix<t_eventfd>::x_;
   using R_eventfd = t_prefix<t_eventfd>::R_;
@@ -24,6 +24,10 @@
 
 ******************************************************************************/
 
+#include <alloca.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <sys/mman.h>
 #include "dainty_os_scheduling.h"
 
 namespace dainty
@@ -32,6 +36,127 @@ namespace os
 {
 namespace scheduling
 {
+  using named::t_uint8;
+
+  namespace
+  {
+    // left untouched below the prefaulted part, for the frames of the
+    // calls that follow and for signal handlers
+    constexpr t_n_ STACK_MARGIN_ = 64*1024;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_errn lock_memory() noexcept {
+    return call_mlockall(MCL_CURRENT | MCL_FUTURE);
+  }
+
+  t_void lock_memory(t_err err) noexcept {
+    ERR_GUARD(err) {
+      call_mlockall(err, MCL_CURRENT | MCL_FUTURE);
+    }
+  }
+
+  t_errn unlock_memory() noexcept {
+    return call_munlockall();
+  }
+
+  t_void unlock_memory(t_err err) noexcept {
+    ERR_GUARD(err) {
+      call_munlockall(err);
+    }
+  }
+
+  t_errn prefault_heap(t_n n) noexcept {
+    auto errn = call_mallopt(M_TRIM_THRESHOLD, -1);
+    if (errn == VALID)
+      errn = call_mallopt(M_MMAP_MAX, 0);
+    if (errn == VALID) {
+      auto ptr = static_cast<volatile t_uint8*>(::malloc(get(n)));
+      if (ptr) {
+        t_n_ page = get(call_getpagesize());
+        for (t_n_ offset = 0; offset < get(n); offset += page)
+          ptr[offset] = 0;
+        ::free(const_cast<t_uint8*>(ptr));
+      } else
+        errn = t_errn{-1};
+    }
+    return errn;
+  }
+
+  t_void prefault_heap(t_err err, t_n n) noexcept {
+    ERR_GUARD(err) {
+      if (prefault_heap(n) == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_n prefault_stack(t_n n) noexcept {
+    t_n_ left = 0;
+    ::pthread_attr_t attr;
+    if (call_pthread_getattr(call_pthread_self(), attr) == VALID) {
+      p_void low  = nullptr;
+      t_n    size{0};
+      if (call_pthread_get_stack(attr, low, size) == VALID) {
+        t_uint8 here = 0;
+        auto top = reinterpret_cast<::uintptr_t>(&here);
+        auto end = reinterpret_cast<::uintptr_t>(low) + STACK_MARGIN_;
+        if (top > end)
+          left = top - end;
+      }
+      call_pthread_destroy(attr);
+    }
+
+    t_n_ bytes = get(n) < left ? get(n) : left;
+    if (bytes) {
+      auto ptr  = static_cast<volatile t_uint8*>(::alloca(bytes));
+      t_n_ page = get(call_getpagesize());
+      for (t_n_ offset = 0; offset < bytes; offset += page)
+        ptr[offset] = 0;
+    }
+    return t_n{bytes};
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_n get_cpus() noexcept {
+    static const t_n cpus = call_get_nprocs_conf();
+    return cpus;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_percpu_counter::t_percpu_counter() noexcept {
+    auto cpus   = named::get(get_cpus());
+    auto verify = call_mmap(t_n{cpus * sizeof(t_slot_)},
+                            PROT_READ | PROT_WRITE, 0);
+    if (verify == VALID) {
+      slots_ = static_cast<t_slot_*>(verify.value);
+      cpus_  = cpus;
+    }
+  }
+
+  t_percpu_counter::t_percpu_counter(t_err err) noexcept {
+    ERR_GUARD(err) {
+      auto cpus = named::get(get_cpus());
+      slots_ = static_cast<t_slot_*>(
+        call_mmap(err, t_n{cpus * sizeof(t_slot_)}, PROT_READ | PROT_WRITE, 0));
+      if (!err)
+        cpus_ = cpus;
+    }
+  }
+
+  t_percpu_counter::~t_percpu_counter() {
+    if (slots_)
+      call_munmap(slots_, t_n{cpus_ * sizeof(t_slot_)});
+  }
+
+  t_percpu_counter::t_value t_percpu_counter::get() const noexcept {
+    t_value sum = 0;
+    for (t_n_ ix = 0; ix < cpus_; ++ix)
+      sum += __atomic_load_n(&slots_[ix].value, __ATOMIC_RELAXED);
+    return sum;
+  }
 }
 }
 }
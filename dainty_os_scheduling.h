@@ -32,6 +32,13 @@
 //
 //  not a complete API but only the things used by dainty.
 
+#if defined(__x86_64__) && __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#if defined(RSEQ_SIG)
+#define DAINTY_OS_RSEQ_
+#endif
+#endif
+
 #include "dainty_named.h"
 #include "dainty_oops.h"
 #include "dainty_os_call.h"
@@ -42,6 +49,179 @@ namespace os
 {
 namespace scheduling
 {
+  using named::t_void;
+  using named::t_bool;
+  using named::t_n_;
+  using named::t_n;
+  using named::t_validity;
+  using named::VALID;
+  using named::INVALID;
+  using err::t_err;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // mlockall(MCL_CURRENT | MCL_FUTURE)
+  t_errn lock_memory()      noexcept;
+  t_void lock_memory(t_err) noexcept;
+
+  t_errn unlock_memory()      noexcept;
+  t_void unlock_memory(t_err) noexcept;
+
+  // stop malloc from trimming or using mmap, then touch n bytes of heap so
+  // later allocations reuse resident pages. call after lock_memory().
+  t_errn prefault_heap(       t_n) noexcept;
+  t_void prefault_heap(t_err, t_n) noexcept;
+
+  // touch n bytes of the calling thread's stack, at most what is left of it
+  // less a 64KB margin. returns the bytes touched.
+  t_n prefault_stack(t_n) noexcept;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // the cpu the caller runs on, it may have moved on by the time it is used.
+  // a plain load from the thread's rseq area when glibc registered one,
+  // sched_getcpu() otherwise.
+  t_n get_cpu() noexcept;
+
+  // upper bound of get_cpu()
+  t_n get_cpus() noexcept;
+
+  // true when the calling thread has a registered rseq area
+  t_bool has_rseq() noexcept;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // a counter split into one cache line per cpu. add() only touches the
+  // slot of the current cpu: a restartable sequence without a locked
+  // instruction when rseq is available, a relaxed fetch_add on the slot
+  // of sched_getcpu() otherwise. get() sums the slots, so it is not a
+  // consistent snapshot while adds are in flight. an invalid counter
+  // ignores add() and get() returns 0.
+  class t_percpu_counter {
+  public:
+    using t_value = named::t_int64;
+
+     t_percpu_counter()      noexcept;
+     t_percpu_counter(t_err) noexcept;
+    ~t_percpu_counter();
+
+    t_percpu_counter(const t_percpu_counter&)            = delete;
+    t_percpu_counter(t_percpu_counter&&)                 = delete;
+    t_percpu_counter& operator=(const t_percpu_counter&) = delete;
+    t_percpu_counter& operator=(t_percpu_counter&&)      = delete;
+
+    operator t_validity() const noexcept;
+
+    t_void  add(t_value = 1) noexcept;
+    t_value get() const noexcept;
+
+  private:
+    struct alignas(64) t_slot_ {
+      t_value value;
+    };
+
+    t_slot_* slots_ = nullptr;
+    t_n_     cpus_  = 0;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(DAINTY_OS_RSEQ_)
+  inline
+  ::rseq* get_rseq_() noexcept {
+    return reinterpret_cast<::rseq*>(
+      static_cast<char*>(__builtin_thread_pointer()) + __rseq_offset);
+  }
+
+  // negative while rseq is not registered for this thread
+  inline
+  named::t_int32 get_rseq_cpu_(::rseq* rs) noexcept {
+    return static_cast<named::t_int32>(
+      __atomic_load_n(&rs->cpu_id, __ATOMIC_RELAXED));
+  }
+
+  // the add commits only if the thread is still on cpu and was neither
+  // preempted nor signalled since the compare, else the kernel restarts
+  // at the abort handler which must be preceded by RSEQ_SIG.
+  inline
+  t_bool rseq_add_(::rseq* rs, named::t_int64& slot, named::t_int64 value,
+                   named::t_int32 cpu) noexcept {
+    asm goto (
+      ".pushsection __rseq_cs, \"aw\"\n\t"
+      ".balign 32\n\t"
+      "3:\n\t"
+      ".long 0x0, 0x0\n\t"
+      ".quad 1f, (2f - 1f), 4f\n\t"
+      ".popsection\n\t"
+      "leaq 3b(%%rip), %%rax\n\t"
+      "movq %%rax, %[rseq_cs]\n\t"
+      "1:\n\t"
+      "cmpl %[cpu], %[cpu_id]\n\t"
+      "jnz %l[abort]\n\t"
+      "addq %[value], %[slot]\n\t"
+      "2:\n\t"
+      ".pushsection __rseq_failure, \"ax\"\n\t"
+      ".byte 0x0f, 0xb9, 0x3d\n\t"
+      ".long %c[sig]\n\t"
+      "4:\n\t"
+      "jmp %l[abort]\n\t"
+      ".popsection\n\t"
+      :
+      : [cpu]     "r"  (cpu),
+        [cpu_id]  "m"  (rs->cpu_id),
+        [rseq_cs] "m"  (rs->rseq_cs),
+        [slot]    "m"  (slot),
+        [value]   "er" (value),
+        [sig]     "i"  (RSEQ_SIG)
+      : "memory", "cc", "rax"
+      : abort);
+    return true;
+  abort:
+    return false;
+  }
+#endif
+
+  inline
+  t_n get_cpu() noexcept {
+#if defined(DAINTY_OS_RSEQ_)
+    auto cpu = get_rseq_cpu_(get_rseq_());
+    if (cpu >= 0)
+      return t_n(cpu);
+#endif
+    return call_sched_getcpu();
+  }
+
+  inline
+  t_bool has_rseq() noexcept {
+#if defined(DAINTY_OS_RSEQ_)
+    return get_rseq_cpu_(get_rseq_()) >= 0;
+#else
+    return false;
+#endif
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_percpu_counter::operator t_validity() const noexcept {
+    return slots_ ? VALID : INVALID;
+  }
+
+  inline
+  t_void t_percpu_counter::add(t_value value) noexcept {
+    if (!slots_)
+      return;
+#if defined(DAINTY_OS_RSEQ_)
+    auto rs = get_rseq_();
+    for (auto cpu = get_rseq_cpu_(rs);
+         cpu >= 0 && static_cast<t_n_>(cpu) < cpus_;
+         cpu = get_rseq_cpu_(rs))
+      if (rseq_add_(rs, slots_[cpu].value, value, cpu))
+        return;
+#endif
+    __atomic_fetch_add(&slots_[named::get(get_cpu()) % cpus_].value, value,
+                       __ATOMIC_RELAXED);
+  }
 }
 }
 }
@@ -0,0 +1,362 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include "dainty_named_assert.h"
+#include "dainty_os_sharding.h"
+
+namespace dainty
+{
+namespace os
+{
+namespace sharding
+{
+
+  namespace
+  {
+    thread_local p_shard current_ = nullptr;
+
+    t_void backoff_(t_n_ spin) noexcept {
+      if (spin < 64)
+        threading::relax_cpu();
+      else
+        call_sched_yield();
+    }
+
+    t_n_ get_cpu_(const t_cpu_set& set, t_n_ nth) noexcept {
+      for (t_n_ cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &set) && !nth--)
+          return cpu;
+      return 0;
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_shard::t_shard(r_runtime runtime, t_shard_id id) noexcept
+      : runtime_(runtime), id_{id}, eventfd_{t_n{0}} {
+    if (eventfd_ == VALID && epoll_ == VALID) {
+      t_epoll::t_event_data data;
+      data.ptr = nullptr;
+      epoll_.add_event(eventfd_.get_fd(), EPOLLIN, data);
+    }
+  }
+
+  p_shard t_shard::get_current() noexcept {
+    return current_;
+  }
+
+  t_errn t_shard::add_event(t_fd fd, t_event_mask mask,
+                            r_shard_handler handler) noexcept {
+    t_epoll::t_event_data data;
+    data.ptr = &handler;
+    return epoll_.add_event(fd, mask, data);
+  }
+
+  t_void t_shard::add_event(t_err err, t_fd fd, t_event_mask mask,
+                            r_shard_handler handler) noexcept {
+    ERR_GUARD(err) {
+      t_epoll::t_event_data data;
+      data.ptr = &handler;
+      epoll_.add_event(err, fd, mask, data);
+    }
+  }
+
+  t_errn t_shard::mod_event(t_fd fd, t_event_mask mask,
+                            r_shard_handler handler) noexcept {
+    t_epoll::t_event_data data;
+    data.ptr = &handler;
+    return epoll_.mod_event(fd, mask, data);
+  }
+
+  t_void t_shard::mod_event(t_err err, t_fd fd, t_event_mask mask,
+                            r_shard_handler handler) noexcept {
+    ERR_GUARD(err) {
+      t_epoll::t_event_data data;
+      data.ptr = &handler;
+      epoll_.mod_event(err, fd, mask, data);
+    }
+  }
+
+  t_errn t_shard::del_event(t_fd fd) noexcept {
+    return epoll_.del_event(fd);
+  }
+
+  t_void t_shard::del_event(t_err err, t_fd fd) noexcept {
+    ERR_GUARD(err) {
+      epoll_.del_event(err, fd);
+    }
+  }
+
+  // the inbox is mapped and first touched here, on the shard's own cpu.
+  // the runtime waits for every shard to get this far before it is used.
+  p_void t_shard::start_(p_void ptr) noexcept {
+    auto& shard  = *static_cast<p_shard>(ptr);
+    auto  verify = call_mmap(t_n{sizeof(t_inbox_)}, PROT_READ | PROT_WRITE, 0);
+    if (verify == VALID)
+      shard.inbox_ = new (verify.value) t_inbox_;
+    shard.runtime_.started_.count_down();
+    if (shard.inbox_) {
+      current_ = &shard;
+      shard.loop_();
+      shard.clear_();
+      current_ = nullptr;
+    }
+    return nullptr;
+  }
+
+  // run inbox tasks and queued replies first. only when the inbox is empty
+  // and parked, and no reply waits, does the shard block in epoll;
+  // otherwise it polls its fds and goes on.
+  t_void t_shard::loop_() noexcept {
+    t_epoll::t_event events[EVENTS_MAX_];
+    while (!stop_) {
+      t_bool block = !work_() && !replies_ && !stop_ && park_();
+      auto verify  = block ? epoll_.wait(events)
+                           : epoll_.wait(events, named::t_usec{0});
+      if (block)
+        unpark_();
+      if (verify == VALID) {
+        for (t_n_ ix = 0; ix < get(verify.value); ++ix) {
+          auto& event = events[ix];
+          if (event.data.ptr)
+            static_cast<t_shard_handler*>(event.data.ptr)
+              ->notify_event(event.events);
+          else {
+            t_eventfd::t_value value = 0;
+            eventfd_.read(value);
+          }
+        }
+      }
+    }
+  }
+
+  t_n_ t_shard::work_() noexcept {
+    return drain_() + retry_();
+  }
+
+  t_n_ t_shard::drain_() noexcept {
+    t_n_ ran = 0;
+    t_task task;
+    for (; ran < INBOX_SIZE && inbox_->try_pop(task); ++ran)
+      task.run();
+    return ran;
+  }
+
+  t_bool t_shard::park_() noexcept {
+    idle_.store(true, std::memory_order_relaxed);
+    // pairs with the fence in t_runtime::push_()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!inbox_->is_empty()) {
+      unpark_();
+      return false;
+    }
+    return true;
+  }
+
+  t_void t_shard::unpark_() noexcept {
+    idle_.store(false, std::memory_order_relaxed);
+  }
+
+  t_void t_shard::queue_(t_n_ to, t_task&& task) noexcept {
+    auto reply = new (std::nothrow) t_reply_{nullptr, to, std::move(task)};
+    if (!reply)
+      assert_now(P_cstr("sharding: no memory to queue a reply"));
+    if (replies_tail_)
+      replies_tail_->next = reply;
+    else
+      replies_ = reply;
+    replies_tail_ = reply;
+  }
+
+  // in order, the first reply that still does not fit stops the retry
+  t_n_ t_shard::retry_() noexcept {
+    t_n_ n = 0;
+    while (replies_ && runtime_.push_(replies_->to,
+                                      std::move(replies_->task))) {
+      auto reply = replies_;
+      replies_   = reply->next;
+      delete reply;
+      ++n;
+    }
+    if (!replies_)
+      replies_tail_ = nullptr;
+    return n;
+  }
+
+  t_void t_shard::clear_() noexcept {
+    while (replies_) {
+      auto reply = replies_;
+      replies_   = reply->next;
+      delete reply;
+    }
+    replies_tail_ = nullptr;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_runtime::t_runtime(t_n shards, t_n first_cpu, t_arena_size arena) noexcept
+      : shards_{get(shards)}, started_{shards} {
+    if (init_(get(first_cpu), arena) == VALID)
+      valid_ = VALID;
+  }
+
+  t_runtime::t_runtime(t_err err, t_n shards, t_n first_cpu,
+                       t_arena_size arena) noexcept
+      : shards_{get(shards)}, started_{shards} {
+    ERR_GUARD(err) {
+      if (init_(get(first_cpu), arena) == VALID)
+        valid_ = VALID;
+      else
+        err = err::E_INIT_FAIL;
+    }
+  }
+
+  t_runtime::~t_runtime() {
+    fini_();
+  }
+
+  t_void t_runtime::stop() noexcept {
+    fini_();
+    valid_ = INVALID;
+  }
+
+  t_errn t_runtime::init_(t_n_ first_cpu, t_arena_size arena) noexcept {
+    if (!shards_)
+      return t_errn{-1};
+
+    t_n_ size   = sizeof(t_shard) * shards_;
+    auto verify = call_mmap(t_n{size}, PROT_READ | PROT_WRITE, 0);
+    if (verify == INVALID)
+      return verify.errn;
+
+    memory_      = verify.value;
+    memory_size_ = size;
+    shard_       = static_cast<p_shard>(memory_);
+
+    for (t_n_ ix = 0; ix < shards_; ++ix)
+      new (shard_ + ix) t_shard(*this, t_shard_id{ix});
+
+    t_cpu_set set;
+    t_errn errn{call_sched_getaffinity(set)};
+    t_n_   cpus = errn == VALID ? CPU_COUNT(&set) : 0;
+    if (!cpus)
+      errn = t_errn{-1};
+    t_n_ started = 0;
+    for (t_n_ ix = 0; errn == VALID && ix < shards_; ++ix) {
+      auto& shard = shard_[ix];
+      if (shard.eventfd_ == VALID && shard.epoll_ == VALID) {
+        ::pthread_attr_t attr;
+        errn = call_pthread_init(attr);
+        if (errn == VALID) {
+          errn = call_pthread_set_affinity(attr,
+                   t_n{get_cpu_(set, (first_cpu + ix) % cpus)});
+          if (errn == VALID)
+            errn = shard.thread_.create(t_shard::start_, &shard, attr, arena);
+          if (errn == VALID)
+            ++started;
+          call_pthread_destroy(attr);
+        }
+      } else
+        errn = t_errn{-1};
+    }
+    if (started < shards_)
+      started_.count_down(t_n{shards_ - started});
+    started_.wait();
+    for (t_n_ n = 0; errn == VALID && n < shards_; ++n)
+      if (!shard_[n].inbox_)
+        errn = t_errn{-1};
+    if (errn == INVALID)
+      fini_();
+    return errn;
+  }
+
+  t_void t_runtime::fini_() noexcept {
+    if (!memory_)
+      return;
+
+    // a shard without an inbox has already returned. the inboxes are only
+    // released once every shard is joined, shards still send to each other.
+    for (t_n_ ix = 0; ix < shards_; ++ix) {
+      auto& shard = shard_[ix];
+      if (shard.thread_ == VALID) {
+        if (shard.inbox_) {
+          t_task stop{[&shard]() { shard.stop_ = true; }};
+          for (t_n_ spin = 0; !push_(ix, std::move(stop)); ++spin)
+            backoff_(spin);
+        }
+        shard.thread_.join();
+      }
+    }
+
+    using t_inbox = t_shard::t_inbox_;
+    for (t_n_ ix = 0; ix < shards_; ++ix) {
+      auto& shard = shard_[ix];
+      if (shard.inbox_) {
+        shard.inbox_->~t_inbox();
+        call_munmap(shard.inbox_, t_n{sizeof(t_inbox)});
+      }
+      shard.~t_shard();
+    }
+
+    call_munmap(memory_, t_n{memory_size_});
+    memory_      = nullptr;
+    memory_size_ = 0;
+    shard_       = nullptr;
+  }
+
+  r_shard t_runtime::get_shard(t_shard_id id) noexcept {
+    if (get(id) >= shards_)
+      assert_now(P_cstr("sharding: no such shard"));
+    return shard_[get(id)];
+  }
+
+  t_bool t_runtime::push_(t_n_ to, t_task&& task) noexcept {
+    if (to >= shards_ || !shard_)
+      return false;
+    auto& shard = shard_[to];
+    if (!shard.inbox_ || !shard.inbox_->try_push(std::move(task)))
+      return false;
+    // pairs with the fence in t_shard::park_()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (shard.idle_.load(std::memory_order_relaxed) &&
+        shard.idle_.exchange(false, std::memory_order_relaxed)) {
+      t_eventfd::t_value one = 1;
+      shard.eventfd_.write(one);
+    }
+    return true;
+  }
+
+  // only runs on a shard, inside the task of a submit_then
+  t_void t_runtime::reply_(t_n_ to, t_task&& task) noexcept {
+    auto& shard = *current_;
+    if (shard.replies_ || !push_(to, std::move(task)))
+      shard.queue_(to, std::move(task));
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
@@ -0,0 +1,507 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_OS_SHARDING_H_
+#define _DAINTY_OS_SHARDING_H_
+
+// description
+// os: operating system functionality used by dainty
+//
+//  thread per core runtime. every shard is a pinned t_thread that owns its
+//  own t_epoll, timers and t_arena. shards share nothing and talk through
+//  one mpmc inbox per shard that is signalled with its eventfd.
+
+#include <cstddef>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "dainty_named.h"
+#include "dainty_oops.h"
+#include "dainty_os_call.h"
+#include "dainty_os_fdbased.h"
+#include "dainty_os_threading.h"
+
+namespace dainty
+{
+namespace os
+{
+namespace sharding
+{
+  using named::p_void;
+  using named::t_void;
+  using named::t_bool;
+  using named::t_validity;
+  using named::t_n_;
+  using named::t_n;
+  using named::t_fd;
+  using named::VALID;
+  using named::INVALID;
+  using err::t_err;
+  using threading::t_arena_size;
+  using threading::t_mpmc_queue;
+  using threading::t_thread;
+  using threading::t_latch;
+  using fdbased::t_epoll;
+  using fdbased::t_eventfd;
+
+  enum  t_shard_id_tag_ {};
+  using t_shard_id = named::t_explicit<t_n_, t_shard_id_tag_>;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // move only callable with inline storage, so an inbox slot never
+  // allocates. a user callable may take CALLABLE_MAX bytes; STORE_MAX
+  // leaves room for the two of them and the runtime pointer and shard id
+  // that submit_then() captures around them.
+  class t_task {
+  public:
+    constexpr static t_n_ CALLABLE_MAX = 48;
+    constexpr static t_n_ STORE_MAX    = 2*CALLABLE_MAX + sizeof(p_void) +
+                                         sizeof(t_n_);
+
+    template<typename F>
+    using t_callable_ = decltype(std::declval<typename std::decay<F>::type&>()());
+
+     t_task() noexcept;
+    template<typename F, typename = t_callable_<F>>
+     t_task(F&&) noexcept;
+     t_task(t_task&&) noexcept;
+    ~t_task();
+
+    t_task& operator=(t_task&&) noexcept;
+
+    t_task(const t_task&)            = delete;
+    t_task& operator=(const t_task&) = delete;
+
+    operator t_validity() const noexcept;
+
+    // runs and releases the callable
+    t_void run() noexcept;
+
+  private:
+    struct t_ops_ {
+      t_void (*run)    (p_void);
+      t_void (*move)   (p_void dst, p_void src);
+      t_void (*destroy)(p_void);
+    };
+    template<typename F> static const t_ops_* get_ops_() noexcept;
+
+    t_void release_() noexcept;
+
+    const t_ops_* ops_ = nullptr;
+    alignas(std::max_align_t) unsigned char store_[STORE_MAX];
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // result of a task run on another shard. it must outlive the task.
+  // get() on a shard keeps running the shard's inbox while it waits,
+  // but not its fds; submit_then() is the better fit there.
+  template<typename T>
+  class t_future {
+  public:
+    using t_value = T;
+    using r_value = typename named::t_prefix<T>::r_;
+
+     t_future() noexcept;
+    ~t_future();
+
+    t_future(const t_future&)            = delete;
+    t_future(t_future&&)                 = delete;
+    t_future& operator=(const t_future&) = delete;
+    t_future& operator=(t_future&&)      = delete;
+
+    t_bool  is_ready() const noexcept;
+    r_value get()            noexcept;
+
+  private:
+    friend class t_runtime;
+    template<typename V> t_void set_(V&&) noexcept;
+
+    t_futex ready_{0};
+    alignas(T) unsigned char value_[sizeof(T)];
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // handler for fds a shard registers on its own epoll
+  class t_shard_handler {
+  public:
+    using t_event_mask = t_epoll::t_event_mask;
+
+    virtual ~t_shard_handler() { }
+    virtual t_void notify_event(t_event_mask) noexcept = 0;
+  };
+  using r_shard_handler = named::t_prefix<t_shard_handler>::r_;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  class t_runtime;
+  using r_runtime = named::t_prefix<t_runtime>::r_;
+
+  class t_shard;
+  using p_shard = named::t_prefix<t_shard>::p_;
+  using r_shard = named::t_prefix<t_shard>::r_;
+
+  class t_shard {
+  public:
+    using t_event_mask = t_epoll::t_event_mask;
+
+    // tasks a shard can hold from all senders together
+    constexpr static t_n_ INBOX_SIZE = 1024;
+
+    t_shard(const t_shard&)            = delete;
+    t_shard(t_shard&&)                 = delete;
+    t_shard& operator=(const t_shard&) = delete;
+    t_shard& operator=(t_shard&&)      = delete;
+
+    // the shard the calling thread runs, nullptr outside a runtime
+    static p_shard get_current() noexcept;
+
+    t_shard_id get_id()      const noexcept;
+    r_runtime  get_runtime()       noexcept;
+
+    // only from the shard's own thread
+    t_errn add_event(       t_fd, t_event_mask, r_shard_handler) noexcept;
+    t_void add_event(t_err, t_fd, t_event_mask, r_shard_handler) noexcept;
+
+    t_errn mod_event(       t_fd, t_event_mask, r_shard_handler) noexcept;
+    t_void mod_event(t_err, t_fd, t_event_mask, r_shard_handler) noexcept;
+
+    t_errn del_event(       t_fd) noexcept;
+    t_void del_event(t_err, t_fd) noexcept;
+
+  private:
+    friend class t_runtime;
+    template<typename> friend class t_future;
+    constexpr static t_n_ EVENTS_MAX_ = 64;
+    using t_inbox_ = t_mpmc_queue<t_task, INBOX_SIZE>;
+
+    // a reply that did not fit in the inbox of the shard it goes to
+    struct t_reply_ {
+      t_reply_* next;
+      t_n_      to;
+      t_task    task;
+    };
+
+    t_shard(r_runtime, t_shard_id) noexcept;
+
+    static p_void start_(p_void) noexcept;
+    t_void        loop_()        noexcept;
+    t_n_          work_()        noexcept;
+    t_n_          drain_()       noexcept;
+    t_bool        park_()        noexcept;
+    t_void        unpark_()      noexcept;
+    t_void        queue_(t_n_ to, t_task&&) noexcept;
+    t_n_          retry_()       noexcept;
+    t_void        clear_()       noexcept;
+
+    r_runtime  runtime_;
+    t_shard_id id_;
+    t_eventfd  eventfd_;
+    t_epoll    epoll_;
+    t_bool     stop_ = false;
+    t_reply_*  replies_      = nullptr;
+    t_reply_*  replies_tail_ = nullptr;
+    t_inbox_*  inbox_        = nullptr;
+    t_thread   thread_;
+    alignas(threading::CACHE_LINE_SIZE) std::atomic<t_bool> idle_{false};
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // bootstrap: shard i is pinned to cpu number (first_cpu + i) % n of the
+  // n cpus in the affinity mask of the creating thread and owns a t_arena
+  // of the given size. every shard maps its own inbox from its own thread,
+  // so the memory is local to its cpu. submit() is lock free from any
+  // thread. a full inbox makes submit() return false, the caller decides
+  // whether to retry.
+  class t_runtime {
+  public:
+     t_runtime(       t_n shards, t_n first_cpu, t_arena_size) noexcept;
+     t_runtime(t_err, t_n shards, t_n first_cpu, t_arena_size) noexcept;
+    ~t_runtime();
+
+    t_runtime(const t_runtime&)            = delete;
+    t_runtime(t_runtime&&)                 = delete;
+    t_runtime& operator=(const t_runtime&) = delete;
+    t_runtime& operator=(t_runtime&&)      = delete;
+
+    operator t_validity() const noexcept;
+
+    t_n     get_shards() const noexcept;
+
+    // asserts that the id is below get_shards()
+    r_shard get_shard(t_shard_id) noexcept;
+
+    template<typename F, typename = t_task::t_callable_<F>>
+    t_bool submit(t_shard_id, F&&) noexcept;
+
+    // runs func on the target and stores its result in the future
+    template<typename T, typename F>
+    t_bool submit(t_shard_id, t_future<T>&, F&& func) noexcept;
+
+    // runs func on the target and then(result) back on the calling shard,
+    // or then() when func returns void. only from a shard of this runtime.
+    // a reply that finds the calling shard's inbox full is queued on the
+    // target and retried from its loop, a shard never blocks on another one.
+    template<typename F, typename C>
+    t_bool submit_then(t_shard_id, F&& func, C&& then) noexcept;
+
+    // ask every shard to stop and join them. not from a shard.
+    t_void stop() noexcept;
+
+  private:
+    friend class t_shard;
+
+    t_errn  init_(t_n_ first_cpu, t_arena_size) noexcept;
+    t_void  fini_() noexcept;
+    t_bool  push_(t_n_ to, t_task&&) noexcept;
+    t_void  reply_(t_n_ to, t_task&&) noexcept;
+
+    template<typename F, typename C>
+    t_task then_(t_n_ back, F&&, C&&, std::false_type) noexcept;
+    template<typename F, typename C>
+    t_task then_(t_n_ back, F&&, C&&, std::true_type) noexcept;
+
+    t_n_       shards_;
+    t_latch    started_;
+    p_void     memory_      = nullptr;
+    t_n_       memory_size_ = 0;
+    p_shard    shard_       = nullptr;
+    t_validity valid_       = INVALID;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_task::t_task() noexcept {
+  }
+
+  template<typename F>
+  inline
+  const t_task::t_ops_* t_task::get_ops_() noexcept {
+    using t_func = typename std::decay<F>::type;
+    static const t_ops_ ops = {
+      [](p_void ptr) { (*static_cast<t_func*>(ptr))(); },
+      [](p_void dst, p_void src) {
+        new (dst) t_func(std::move(*static_cast<t_func*>(src)));
+        static_cast<t_func*>(src)->~t_func();
+      },
+      [](p_void ptr) { static_cast<t_func*>(ptr)->~t_func(); }
+    };
+    return &ops;
+  }
+
+  template<typename F, typename>
+  inline
+  t_task::t_task(F&& func) noexcept : ops_{get_ops_<F>()} {
+    using t_func = typename std::decay<F>::type;
+    static_assert(sizeof(t_func) <= STORE_MAX, "t_task: callable too large");
+    static_assert(alignof(t_func) <= alignof(std::max_align_t),
+                  "t_task: callable over aligned");
+    new (store_) t_func(std::forward<F>(func));
+  }
+
+  inline
+  t_task::t_task(t_task&& task) noexcept : ops_{task.ops_} {
+    if (ops_) {
+      ops_->move(store_, task.store_);
+      task.ops_ = nullptr;
+    }
+  }
+
+  inline
+  t_task::~t_task() {
+    release_();
+  }
+
+  inline
+  t_task& t_task::operator=(t_task&& task) noexcept {
+    if (this != &task) {
+      release_();
+      if (task.ops_) {
+        ops_ = task.ops_;
+        ops_->move(store_, task.store_);
+        task.ops_ = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  inline
+  t_task::operator t_validity() const noexcept {
+    return ops_ ? VALID : INVALID;
+  }
+
+  inline
+  t_void t_task::run() noexcept {
+    if (ops_) {
+      ops_->run(store_);
+      release_();
+    }
+  }
+
+  inline
+  t_void t_task::release_() noexcept {
+    if (ops_) {
+      ops_->destroy(store_);
+      ops_ = nullptr;
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T>
+  inline
+  t_future<T>::t_future() noexcept {
+  }
+
+  template<typename T>
+  inline
+  t_future<T>::~t_future() {
+    if (is_ready())
+      reinterpret_cast<T*>(value_)->~T();
+  }
+
+  template<typename T>
+  inline
+  t_bool t_future<T>::is_ready() const noexcept {
+    return ready_.load(std::memory_order_acquire);
+  }
+
+  template<typename T>
+  inline
+  typename t_future<T>::r_value t_future<T>::get() noexcept {
+    p_shard shard = t_shard::get_current();
+    while (!ready_.load(std::memory_order_acquire)) {
+      if (!shard)
+        call_futex_wait(ready_, 0);
+      else if (!shard->work_())
+        call_sched_yield();
+    }
+    return *reinterpret_cast<T*>(value_);
+  }
+
+  template<typename T>
+  template<typename V>
+  inline
+  t_void t_future<T>::set_(V&& value) noexcept {
+    new (value_) T(std::forward<V>(value));
+    ready_.store(1, std::memory_order_release);
+    call_futex_wake_all(ready_);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_shard_id t_shard::get_id() const noexcept {
+    return id_;
+  }
+
+  inline
+  r_runtime t_shard::get_runtime() noexcept {
+    return runtime_;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_runtime::operator t_validity() const noexcept {
+    return valid_;
+  }
+
+  inline
+  t_n t_runtime::get_shards() const noexcept {
+    return t_n{shards_};
+  }
+
+  template<typename F, typename>
+  inline
+  t_bool t_runtime::submit(t_shard_id to, F&& func) noexcept {
+    return push_(get(to), t_task{std::forward<F>(func)});
+  }
+
+  template<typename T, typename F>
+  inline
+  t_bool t_runtime::submit(t_shard_id to, t_future<T>& future,
+                           F&& func) noexcept {
+    using t_func = typename std::decay<F>::type;
+    t_future<T>* result = &future;
+    return push_(get(to), t_task{
+      [result, func = t_func(std::forward<F>(func))]() mutable {
+        result->set_(func());
+      }});
+  }
+
+  template<typename F, typename C>
+  inline
+  t_bool t_runtime::submit_then(t_shard_id to, F&& func, C&& then) noexcept {
+    using t_func = typename std::decay<F>::type;
+    using t_then = typename std::decay<C>::type;
+    static_assert(sizeof(t_func) <= t_task::CALLABLE_MAX,
+                  "submit_then: func too large");
+    static_assert(sizeof(t_then) <= t_task::CALLABLE_MAX,
+                  "submit_then: then too large");
+    using t_void_ = std::is_void<decltype(std::declval<t_func&>()())>;
+    p_shard from = t_shard::get_current();
+    if (!from || &from->runtime_ != this)
+      return false;
+    return push_(get(to), then_(get(from->id_), t_func(std::forward<F>(func)),
+                                t_then(std::forward<C>(then)), t_void_{}));
+  }
+
+  template<typename F, typename C>
+  inline
+  t_task t_runtime::then_(t_n_ back, F&& func, C&& then,
+                          std::false_type) noexcept {
+    return t_task{
+      [this, back, func = std::move(func), then = std::move(then)]() mutable {
+        reply_(back, t_task{
+          [then = std::move(then), result = func()]() mutable {
+            then(std::move(result));
+          }});
+      }};
+  }
+
+  template<typename F, typename C>
+  inline
+  t_task t_runtime::then_(t_n_ back, F&& func, C&& then,
+                          std::true_type) noexcept {
+    return t_task{
+      [this, back, func = std::move(func), then = std::move(then)]() mutable {
+        func();
+        reply_(back, t_task{[then = std::move(then)]() mutable { then(); }});
+      }};
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
@@ -24,9 +24,69 @@
 
 ******************************************************************************/
 
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/membarrier.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include "dainty_os_clock.h"
 #include "dainty_os_threading.h"
 
+#if defined(__x86_64__)
+// save the callee saved registers, mxcsr and the x87 control word on the
+// current stack, store its pointer in *save and continue on the stack load.
+// start: first entry of a fiber, calls r13(r12).
+extern "C" {
+  __attribute__((visibility("hidden")))
+  void dainty_os_fiber_switch_(void** save, void* load) noexcept;
+  __attribute__((visibility("hidden")))
+  void dainty_os_fiber_start_() noexcept;
+}
+
+asm(R"(
+  .pushsection .text
+  .globl  dainty_os_fiber_switch_
+  .hidden dainty_os_fiber_switch_
+  .type   dainty_os_fiber_switch_, @function
+  .p2align 4
+dainty_os_fiber_switch_:
+  pushq   %rbp
+  pushq   %rbx
+  pushq   %r12
+  pushq   %r13
+  pushq   %r14
+  pushq   %r15
+  subq    $16, %rsp
+  stmxcsr 8(%rsp)
+  fnstcw  (%rsp)
+  movq    %rsp, (%rdi)
+  movq    %rsi, %rsp
+  fldcw   (%rsp)
+  ldmxcsr 8(%rsp)
+  addq    $16, %rsp
+  popq    %r15
+  popq    %r14
+  popq    %r13
+  popq    %r12
+  popq    %rbx
+  popq    %rbp
+  ret
+  .size   dainty_os_fiber_switch_, .-dainty_os_fiber_switch_
+
+  .globl  dainty_os_fiber_start_
+  .hidden dainty_os_fiber_start_
+  .type   dainty_os_fiber_start_, @function
+  .p2align 4
+dainty_os_fiber_start_:
+  movq    %r12, %rdi
+  callq   *%r13
+  ud2
+  .size   dainty_os_fiber_start_, .-dainty_os_fiber_start_
+  .popsection
+)");
+#endif
+
 namespace dainty
 {
 namespace os
@@ -35,6 +95,166 @@ namespace threading
 {
   using clock::to_;
 
+  namespace
+  {
+    t_errn set_mutex_params_(r_pthread_mutexattr attr,
+                             R_mutex_params params) noexcept {
+      t_errn errn{0};
+      if (params.protocol == MUTEX_PRIO_INHERIT)
+        errn = call_pthread_set_prio_inherit(attr);
+      else if (params.protocol == MUTEX_PRIO_PROTECT)
+        errn = call_pthread_set_prio_protect(attr, params.ceiling);
+      if (errn == VALID && params.robust)
+        errn = call_pthread_set_robust(attr);
+      if (errn == VALID && params.scope == PROCESS_SHARED)
+        errn = call_pthread_set_shared(attr);
+      return errn;
+    }
+
+    // err for a failed lock or wait
+    t_void set_lock_err_(t_err err, t_errn errn) noexcept {
+      switch (get(errn)) {
+        case ENOTRECOVERABLE:
+          err = err::E_NOT_RECOVERABLE;
+          break;
+        case ETIMEDOUT:
+          err = err::E_TIMEOUT;
+          break;
+        default:
+          err = err::E_XXX;
+          break;
+      }
+    }
+
+    thread_local t_arena* thread_arena_ = nullptr;
+
+    struct t_start_ {
+      p_run        run;
+      p_void       arg;
+      t_arena_size arena_size;
+      t_futex      started{0};
+    };
+
+    // a handoff flag goes 0 -> 1 -> 2. at 1 the wake is still to be issued
+    // on it, only at 2 has the notifier stopped touching it and the waiter
+    // may release the memory it lives in.
+    t_void wait_handoff_(t_futex& flag) noexcept {
+      for (;;) {
+        auto state = flag.load(std::memory_order_acquire);
+        if (state == 2)
+          break;
+        if (state == 0)
+          call_futex_wait(flag, 0);
+        else
+          call_sched_yield();
+      }
+    }
+
+    t_void notify_handoff_(t_futex& flag) noexcept {
+      flag.store(1, std::memory_order_release);
+      call_futex_wake(flag, t_n{1});
+      flag.store(2, std::memory_order_release);
+    }
+
+    t_void wait_started_(t_start_& start) noexcept {
+      wait_handoff_(start.started);
+    }
+
+    // after this the creator may release start
+    t_void notify_started_(t_start_& start) noexcept {
+      notify_handoff_(start.started);
+    }
+
+    struct t_thread_arena_scope_ {
+      t_thread_arena_scope_(t_arena& arena) noexcept {
+        if (arena == VALID)
+          thread_arena_ = &arena;
+      }
+      ~t_thread_arena_scope_() {
+        thread_arena_ = nullptr;
+      }
+    };
+
+    p_void start_thread_(p_void ptr) {
+      t_thread_registry::t_scope registry;
+      auto   start = static_cast<t_start_*>(ptr);
+      p_run  run   = start->run;
+      p_void arg   = start->arg;
+      if (get(start->arena_size)) {
+        t_arena arena{start->arena_size};
+        notify_started_(*start);
+        t_thread_arena_scope_ scope{arena};
+        return run(arg);
+      }
+      notify_started_(*start);
+      return run(arg);
+    }
+
+    struct t_thread_slot_ {
+      std::atomic<t_bool>          used{false};
+      std::atomic<t_pid>           tid{0};
+      std::atomic<::pthread_t>     thread{};
+      std::atomic<named::t_uint64> name[2] = {};
+    };
+
+    t_thread_slot_ thread_slots_[t_thread_registry::THREADS_MAX];
+    thread_local t_thread_slot_* thread_slot_ = nullptr;
+
+    // the name may tear when set concurrently, it is only for reporting
+    t_void store_name_(t_thread_slot_& slot, P_cstr name) noexcept {
+      named::t_uint64 words[2] = {};
+      std::memcpy(words, get(name), ::strnlen(get(name), sizeof(words) - 1));
+      slot.name[0].store(words[0], std::memory_order_relaxed);
+      slot.name[1].store(words[1], std::memory_order_relaxed);
+    }
+
+    t_void load_name_(t_thread_slot_& slot, char (&name)[16]) noexcept {
+      named::t_uint64 words[2] = {slot.name[0].load(std::memory_order_relaxed),
+                                  slot.name[1].load(std::memory_order_relaxed)};
+      std::memcpy(name, words, sizeof(name));
+      name[sizeof(name) - 1] = '\0';
+    }
+
+    t_n_ read_task_file_(t_pid tid, const char* file, char* buf,
+                         t_n_ max) noexcept {
+      char path[64];
+      std::snprintf(path, sizeof(path), "/proc/self/task/%d/%s", tid, file);
+      t_n_ len = 0;
+      auto verify = call_open(P_cstr{path}, O_RDONLY);
+      if (verify == VALID) {
+        auto fd   = verify.value;
+        auto read = call_read(fd, buf, t_n{max - 1});
+        if (read == VALID)
+          len = get(read.value);
+        call_close(fd);
+      }
+      buf[len] = '\0';
+      return len;
+    }
+
+    named::t_uint64 find_value_(const char* buf, const char* key) noexcept {
+      const char* pos = std::strstr(buf, key);
+      return pos ? std::strtoull(pos + std::strlen(key), nullptr, 10) : 0;
+    }
+
+    t_void read_sched_(t_thread_stats& stats) noexcept {
+      char buf[4096];
+      if (read_task_file_(stats.tid, "status", buf, sizeof(buf))) {
+        stats.voluntary   = find_value_(buf, "\nvoluntary_ctxt_switches:");
+        stats.involuntary = find_value_(buf, "\nnonvoluntary_ctxt_switches:");
+      }
+      // <time on cpu ns> <time waiting on a runqueue ns> <timeslices>
+      if (read_task_file_(stats.tid, "schedstat", buf, sizeof(buf))) {
+        char* pos = buf;
+        std::strtoull(pos, &pos, 10);
+        stats.run_delay  = t_time{named::t_nsec(std::strtoull(pos, &pos, 10))};
+        stats.timeslices = std::strtoull(pos, &pos, 10);
+      }
+    }
+
+    const t_errn fences_ = register_fences();
+  }
+
 ///////////////////////////////////////////////////////////////////////////////
 
   t_mutex_lock::t_mutex_lock() noexcept {
@@ -60,26 +280,48 @@ namespace threading
     }
   }
 
+  t_mutex_lock::t_mutex_lock(R_mutex_params params) noexcept {
+    ::pthread_mutexattr_t attr;
+    if (call_pthread_init(attr) == VALID) {
+      if (set_mutex_params_(attr, params) == VALID &&
+          call_pthread_mutex_init(mutex_, attr) == VALID)
+        valid_ = VALID;
+      call_pthread_destroy(attr);
+    }
+  }
+
+  t_mutex_lock::t_mutex_lock(t_err err, R_mutex_params params) noexcept {
+    ERR_GUARD(err) {
+      ::pthread_mutexattr_t attr;
+      call_pthread_init(err, attr);
+      if (!err) {
+        if (set_mutex_params_(attr, params) == VALID) {
+          call_pthread_mutex_init(err.tag(1), mutex_, attr);
+          valid_ = !err ? VALID : INVALID;
+        } else
+          err = err::E_INIT_FAIL;
+        call_pthread_destroy(attr);
+      }
+    }
+  }
+
   t_mutex_lock::~t_mutex_lock() {
     if (valid_ == VALID)
       call_pthread_mutex_destroy(mutex_);
   }
 
   t_mutex_lock::t_locked_scope t_mutex_lock::make_locked_scope() noexcept {
-    if (valid_ == VALID && call_pthread_mutex_lock(mutex_) == VALID)
-      return {this};
+    if (valid_ == VALID)
+      return locked_(call_pthread_mutex_lock(mutex_));
     return {nullptr};
   }
 
   t_mutex_lock::t_locked_scope
       t_mutex_lock::make_locked_scope(t_err err) noexcept {
     ERR_GUARD(err) {
-      if (valid_ == VALID) {
-        call_pthread_mutex_lock(err, mutex_);
-        if (!err)
-          return {this};
-      } else
-        err = err::E_INVALID_INST;
+      if (valid_ == VALID)
+        return locked_(err, call_pthread_mutex_lock(mutex_));
+      err = err::E_INVALID_INST;
     }
     return {nullptr};
   }
@@ -87,39 +329,85 @@ namespace threading
   t_mutex_lock::t_locked_scope
       t_mutex_lock::make_locked_scope(t_err err, t_time time) noexcept {
     ERR_GUARD(err) {
-      if (valid_ == VALID) {
-        call_pthread_mutex_timedlock(err, mutex_, to_(time));
-        if (!err)
-          return {this};
-      } else
-        err = err::E_INVALID_INST;
+      t_deadline deadline{err, time};
+      return make_locked_scope(err, deadline);
     }
     return {nullptr};
   }
 
   t_mutex_lock::t_locked_scope
       t_mutex_lock::make_locked_scope(t_time time) noexcept {
-    if (valid_ == VALID &&
-        call_pthread_mutex_timedlock(mutex_, to_(time)) == VALID)
-      return {this};
+    return make_locked_scope(t_deadline{time});
+  }
+
+  t_mutex_lock::t_locked_scope
+      t_mutex_lock::make_locked_scope(t_err err,
+                                      t_deadline deadline) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID)
+        return locked_(err, call_pthread_mutex_clocklock(mutex_,
+                              CLOCK_MONOTONIC, to_(deadline.get_time())));
+      err = err::E_INVALID_INST;
+    }
+    return {nullptr};
+  }
+
+  t_mutex_lock::t_locked_scope
+      t_mutex_lock::make_locked_scope(t_deadline deadline) noexcept {
+    if (valid_ == VALID)
+      return locked_(call_pthread_mutex_clocklock(mutex_, CLOCK_MONOTONIC,
+                                                  to_(deadline.get_time())));
     return {nullptr};
   }
 
   t_mutex_lock::t_locked_scope
       t_mutex_lock::trymake_locked_scope(t_err err) noexcept {
     ERR_GUARD(err) {
-      if (valid_ == VALID) {
-        call_pthread_mutex_trylock(err, mutex_);
-        if (!err)
-          return {this};
-      } else
-        err = err::E_INVALID_INST;
+      if (valid_ == VALID)
+        return locked_(err, call_pthread_mutex_trylock(mutex_));
+      err = err::E_INVALID_INST;
     }
     return {nullptr};
   }
 
   t_mutex_lock::t_locked_scope t_mutex_lock::trymake_locked_scope() noexcept {
-    if (valid_ == VALID && call_pthread_mutex_trylock(mutex_) == VALID)
+    if (valid_ == VALID)
+      return locked_(call_pthread_mutex_trylock(mutex_));
+    return {nullptr};
+  }
+
+  t_errn t_mutex_lock::make_consistent() noexcept {
+    auto errn = call_pthread_mutex_consistent(mutex_);
+    if (errn == VALID)
+      dead_ = false;
+    return errn;
+  }
+
+  t_void t_mutex_lock::make_consistent(t_err err) noexcept {
+    ERR_GUARD(err) {
+      if (call_pthread_mutex_consistent(mutex_) == VALID)
+        dead_ = false;
+      else
+        err = err::E_XXX;
+    }
+  }
+
+  // a dead owner is not an error, the caller checks is_owner_dead()
+  t_errn t_mutex_lock::mark_(t_err err, t_errn errn) noexcept {
+    if (mark_(errn) == INVALID && get(errn) != EOWNERDEAD)
+      set_lock_err_(err, errn);
+    return errn;
+  }
+
+  t_mutex_lock::t_locked_scope t_mutex_lock::locked_(t_errn errn) noexcept {
+    if (mark_(errn) == VALID || get(errn) == EOWNERDEAD)
+      return {this};
+    return {nullptr};
+  }
+
+  t_mutex_lock::t_locked_scope t_mutex_lock::locked_(t_err err,
+                                                     t_errn errn) noexcept {
+    if (mark_(err, errn) == VALID || get(errn) == EOWNERDEAD)
       return {this};
     return {nullptr};
   }
@@ -201,12 +489,27 @@ namespace threading
     return {nullptr};
   }
 
+  t_recursive_mutex_lock::t_locked_scope
+      t_recursive_mutex_lock::make_locked_scope(t_err err, t_time time) noexcept {
+    ERR_GUARD(err) {
+      t_deadline deadline{err, time};
+      return make_locked_scope(err, deadline);
+    }
+    return {nullptr};
+  }
+
+  t_recursive_mutex_lock::t_locked_scope
+      t_recursive_mutex_lock::make_locked_scope(t_time time) noexcept {
+    return make_locked_scope(t_deadline{time});
+  }
+
   t_recursive_mutex_lock::t_locked_scope
       t_recursive_mutex_lock::make_locked_scope(t_err err,
-                                                t_time time) noexcept {
+                                                t_deadline deadline) noexcept {
     ERR_GUARD(err) {
       if (valid_ == VALID) {
-        call_pthread_mutex_timedlock(err, mutex_, to_(time));
+        call_pthread_mutex_clocklock(err, mutex_, CLOCK_MONOTONIC,
+                                     to_(deadline.get_time()));
         if (!err)
           return {this};
       } else
@@ -216,9 +519,10 @@ namespace threading
   }
 
   t_recursive_mutex_lock::t_locked_scope
-      t_recursive_mutex_lock::make_locked_scope(t_time time) noexcept {
+      t_recursive_mutex_lock::make_locked_scope(t_deadline deadline) noexcept {
     if (valid_ == VALID &&
-        call_pthread_mutex_timedlock(mutex_, to_(time)) == VALID)
+        call_pthread_mutex_clocklock(mutex_, CLOCK_MONOTONIC,
+                                     to_(deadline.get_time())) == VALID)
       return {this};
     return {nullptr};
   }
@@ -253,6 +557,74 @@ namespace threading
     // can  use for debugging
   }
 
+  t_errn t_recursive_mutex_lock::mark_(t_err err, t_errn errn) noexcept {
+    if (errn == INVALID)
+      set_lock_err_(err, errn);
+    return errn;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_errn register_fences() noexcept {
+    t_errn errn{0};
+    if (!has_heavy_fence()) {
+      errn = call_membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED);
+      if (errn == VALID)
+        fences_registered_.store(true, std::memory_order_relaxed);
+    }
+    return errn;
+  }
+
+  t_void register_fences(t_err err) noexcept {
+    ERR_GUARD(err) {
+      if (register_fences() == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_errn heavy_fence() noexcept {
+    if (has_heavy_fence())
+      return call_membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return t_errn{0};
+  }
+
+  t_void heavy_fence(t_err err) noexcept {
+    ERR_GUARD(err) {
+      if (heavy_fence() == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_n_ get_spin_max_(t_n_ max) noexcept {
+    static const t_bool smp = get(call_get_nprocs()) > 1;
+    return smp ? max : 0;
+  }
+
+  t_void t_spin_park_::adapt_(t_n_ budget, t_n_ spun, t_bool hit) noexcept {
+    t_n_ next = budget / 2;
+    if (hit) {
+      t_n_ want = 2 * spun;
+      next = want > budget ? budget + (want - budget) / 8
+                           : budget - (budget - want) / 8;
+    }
+    next = next < SPIN_MIN ? SPIN_MIN : next > SPIN_MAX ? SPIN_MAX : next;
+    budget_.store(next, std::memory_order_relaxed);
+    if (hit)
+      hits_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  t_spin_stats t_spin_park_::get_stats() const noexcept {
+    t_spin_stats stats;
+    stats.spins     = spins_.load(std::memory_order_relaxed);
+    stats.spin_hits = hits_ .load(std::memory_order_relaxed);
+    stats.parks     = parks_.load(std::memory_order_relaxed);
+    stats.budget    = budget_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
 ///////////////////////////////////////////////////////////////////////////////
 
   t_cond_var::t_cond_var() noexcept {
@@ -354,7 +726,7 @@ namespace threading
     ::pthread_condattr_t attr;
     if (call_pthread_init(attr) == VALID) {
       if (call_pthread_set_monotonic(attr) == VALID &&
-          call_pthread_cond_init(cond_) == VALID)
+          call_pthread_cond_init(cond_, attr) == VALID)
         valid_ = VALID;
       call_pthread_destroy(attr);
     }
@@ -466,6 +838,26 @@ namespace threading
     }
   }
 
+  t_errn t_monotonic_cond_var::wait_until_(r_pthread_mutex mutex,
+                                           t_deadline deadline) noexcept {
+    t_errn errn{-1};
+    if (valid_ == VALID)
+      errn = call_pthread_cond_timedwait(cond_, mutex,
+                                         to_(deadline.get_time()));
+    return errn;
+  }
+
+  t_void t_monotonic_cond_var::wait_until_(t_err err, r_pthread_mutex mutex,
+                                           t_deadline deadline) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID)
+        call_pthread_cond_timedwait(err, cond_, mutex,
+                                    to_(deadline.get_time()));
+      else
+        err = err::E_INVALID_INST;
+    }
+  }
+
 ///////////////////////////////////////////////////////////////////////////////
 
   t_monotonic_lock::t_monotonic_lock() noexcept {
@@ -516,7 +908,7 @@ namespace threading
       ::pthread_t th = call_pthread_self();
       <% auto scope = mutex_.make_locked_scope();
         if (scope == VALID) {
-          t_errn errn{-1};
+          t_errn errn{0};
           if (!cnt_) {
             owner_ = th;
             cnt_   = 1;
@@ -584,10 +976,25 @@ namespace threading
 
   t_monotonic_lock::t_locked_scope
     t_monotonic_lock::make_locked_scope(t_err err, t_time time) noexcept {
+    ERR_GUARD(err) {
+      t_deadline deadline{err, time};
+      return make_locked_scope(err, deadline);
+    }
+    return {nullptr};
+  }
+
+  t_monotonic_lock::t_locked_scope
+    t_monotonic_lock::make_locked_scope(t_time time) noexcept {
+    return make_locked_scope(t_deadline{time});
+  }
+
+  t_monotonic_lock::t_locked_scope
+    t_monotonic_lock::make_locked_scope(t_err err,
+                                        t_deadline deadline) noexcept {
     ERR_GUARD(err) {
       if (*this == VALID) {
         ::pthread_t th = call_pthread_self();
-        <% auto scope = mutex_.make_locked_scope(err);
+        <% auto scope = mutex_.make_locked_scope(err, deadline);
           if (scope == VALID) {
             if (!cnt_) {
               owner_ = th;
@@ -596,7 +1003,7 @@ namespace threading
               ++cnt_;
             else {
               do {
-                cond_.wait_for(err, mutex_, time);
+                cond_.wait_until(err, mutex_, deadline);
               } while (!err && cnt_);
               if (!err) {
                 owner_ = th;
@@ -614,12 +1021,12 @@ namespace threading
   }
 
   t_monotonic_lock::t_locked_scope
-    t_monotonic_lock::make_locked_scope(t_time time) noexcept {
+    t_monotonic_lock::make_locked_scope(t_deadline deadline) noexcept {
     if (*this == VALID) {
       ::pthread_t th = call_pthread_self();
-      <% auto scope = mutex_.make_locked_scope();
+      <% auto scope = mutex_.make_locked_scope(deadline);
         if (scope == VALID) {
-          t_errn errn{-1};
+          t_errn errn{0};
           if (!cnt_) {
             owner_ = th;
             cnt_   = 1;
@@ -627,7 +1034,7 @@ namespace threading
             ++cnt_;
           else {
             do {
-              errn = cond_.wait_for(mutex_, time);
+              errn = cond_.wait_until(mutex_, deadline);
             } while (errn == VALID && cnt_);
             if (errn == VALID) {
               owner_ = th;
@@ -663,110 +1070,732 @@ namespace threading
 
 ///////////////////////////////////////////////////////////////////////////////
 
-  t_thread::t_thread() noexcept {
+  t_errn t_event_count::wait(t_key key) noexcept {
+    auto errn = call_futex_wait(seq_, key);
+    leave_();
+    if (get(errn) == EAGAIN || get(errn) == EINTR)
+      return t_errn{0};
+    return errn;
   }
 
-  t_thread::t_thread(p_run run, p_void arg) noexcept {
-    create(run, arg);
+  t_void t_event_count::wait(t_err err, t_key key) noexcept {
+    ERR_GUARD(err) {
+      call_futex_wait(err, seq_, key);
+    }
+    leave_();
   }
 
-  t_thread::t_thread(t_err err, p_run run, p_void arg) noexcept {
-    create(err, run, arg);
+  t_errn t_event_count::wait_until(t_key key, t_deadline deadline) noexcept {
+    auto errn = call_futex_wait_until(seq_, key, to_(deadline.get_time()));
+    leave_();
+    if (get(errn) == EAGAIN || get(errn) == EINTR)
+      return t_errn{0};
+    return errn;
   }
 
-  t_thread::t_thread(p_run run, p_void arg, R_pthread_attr attr) noexcept {
-    create(run, arg, attr);
+  t_void t_event_count::wait_until(t_err err, t_key key,
+                                   t_deadline deadline) noexcept {
+    ERR_GUARD(err) {
+      call_futex_wait_until(err, seq_, key, to_(deadline.get_time()));
+    }
+    leave_();
+  }
+
+  // a leaving waiter takes one of the woken with it, whether it was the
+  // one woken or not. that can only cause an extra wake, never a lost one.
+  t_void t_event_count::leave_() noexcept {
+    auto waiters = waiters_.load(std::memory_order_relaxed);
+    t_waiters_ next;
+    do
+      next = waiters - WAITER_ - ((waiters >> 32) ? WOKEN_ : 0);
+    while (!waiters_.compare_exchange_weak(waiters, next,
+                                           std::memory_order_relaxed));
+  }
+
+  // claim the wake of one waiter, or of all of them, that no other notify
+  // has claimed. only the claimer enters the kernel.
+  t_void t_event_count::wake_(t_waiters_ waiters, t_bool all) noexcept {
+    t_waiters_ next;
+    do {
+      auto waiting = waiters & (WOKEN_ - 1);
+      auto woken   = waiters >> 32;
+      if (waiting <= woken)
+        return;
+      next = waiting | ((all ? waiting : woken + 1) << 32);
+    } while (!waiters_.compare_exchange_weak(waiters, next,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_relaxed));
+    seq_.fetch_add(1, std::memory_order_release);
+    if (all)
+      call_futex_wake_all(seq_);
+    else
+      call_futex_wake(seq_, t_n{1});
   }
 
-  t_thread::t_thread(t_err err, p_run run, p_void arg,
-                     R_pthread_attr attr) noexcept {
-    create(err, run, arg, attr);
-  }
+///////////////////////////////////////////////////////////////////////////////
 
-  t_thread::~t_thread() {
-    if (valid_ == VALID && join_)
-      join();
+  t_semaphore::t_semaphore(t_n cnt) noexcept
+    : cnt_{static_cast<t_value>(get(cnt))}, valid_{VALID} {
   }
 
-  t_errn t_thread::create(p_run run, p_void arg) noexcept {
-    t_errn errn{-1};
-    if (valid_ == INVALID) {
-      errn = call_pthread_create(thread_, run, arg);
-      if (errn == VALID) {
-        join_  = true;
-        valid_ = VALID;
-      }
+  t_semaphore::t_semaphore(t_err err, t_n cnt) noexcept
+    : cnt_{static_cast<t_value>(get(cnt))} {
+    ERR_GUARD(err) {
+      valid_ = VALID;
     }
-    return errn;
   }
 
-  t_void t_thread::create(t_err err, p_run run, p_void arg) noexcept {
+  t_semaphore::t_semaphore(t_n cnt, t_process_scope scope) noexcept
+    : cnt_{static_cast<t_value>(get(cnt))}, scope_{scope}, valid_{VALID} {
+  }
+
+  t_semaphore::t_semaphore(t_err err, t_n cnt,
+                           t_process_scope scope) noexcept
+    : cnt_{static_cast<t_value>(get(cnt))}, scope_{scope} {
     ERR_GUARD(err) {
-      if (valid_ == INVALID) {
-        call_pthread_create(err, thread_, run, arg);
-        if (!err) {
-          join_  = true;
-          valid_ = VALID;
-        }
-      } else
-        err = err::E_VALID_INST;
+      valid_ = VALID;
     }
   }
 
-  t_errn t_thread::create(p_run run, p_void arg,
-                          R_pthread_attr attr) noexcept {
-    t_errn errn{-1};
-    if (valid_ == INVALID) {
-      errn = call_pthread_create(thread_, attr, run, arg);
-      if (errn == VALID) {
-        join_ = !call_pthread_is_detach(attr);
-        valid_ = VALID;
-      }
-    }
-    return errn;
+  t_semaphore::~t_semaphore() {
   }
 
-  t_void t_thread::create(t_err err, p_run run, p_void arg,
-                          R_pthread_attr attr) noexcept {
+  t_void t_semaphore::post(t_err err, t_n n) noexcept {
     ERR_GUARD(err) {
-      if (valid_ == INVALID) {
-        call_pthread_create(err, thread_, attr, run, arg);
-        if (!err) {
-          join_  = !call_pthread_is_detach(attr);
-          valid_ = VALID;
-        }
+      if (valid_ == VALID) {
+        if (post(n) != VALID)
+          err = err::E_XXX;
       } else
         err = err::E_INVALID_INST;
     }
   }
 
-  t_errn t_thread::detach() noexcept {
-    t_errn errn{-1};
-    if (valid_ == VALID && join_) {
-      errn = call_pthread_detach(thread_);
-      if (errn == VALID)
-        join_ = false;
-    }
-    return errn;
+  t_errn t_semaphore::wake_(t_n n) noexcept {
+    return call_futex_wake(cnt_, n, scope_).errn;
   }
 
-  t_void t_thread::detach(t_err err) noexcept {
+  t_errn t_semaphore::wait(t_time time) noexcept {
+    t_deadline deadline{time};
+    return wait_(&deadline);
+  }
+
+  t_void t_semaphore::wait(t_err err, t_time time) noexcept {
     ERR_GUARD(err) {
-      if (valid_ == VALID && join_) {
-        call_pthread_detach(err, thread_);
-        if (!err)
-          join_ = false;
-      } else
-        err = err::E_INVALID_INST;
+      t_deadline deadline{err, time};
+      wait_(err, &deadline);
     }
   }
 
-  t_errn t_thread::join() noexcept {
-    t_errn errn{-1};
-    if (valid_ == VALID && join_) {
-      errn = call_pthread_join(thread_);
+  t_errn t_semaphore::wait(t_deadline deadline) noexcept {
+    return wait_(&deadline);
+  }
+
+  t_void t_semaphore::wait(t_err err, t_deadline deadline) noexcept {
+    wait_(err, &deadline);
+  }
+
+  t_errn t_semaphore::wait_(const t_deadline* deadline) noexcept {
+    if (valid_ == INVALID)
+      return t_errn{-1};
+    for (t_n_ spin = 0, max = get_spin_max_(SPIN_MAX_); spin < max; ++spin) {
+      if (try_wait())
+        return t_errn{0};
+      relax_cpu();
+    }
+    for (;;) {
+      waiters_.fetch_add(1, std::memory_order_seq_cst);
+      t_errn errn{0};
+      if (!cnt_.load(std::memory_order_seq_cst))
+        errn = deadline ? call_futex_wait_until(cnt_, 0, to_(deadline->get_time()),
+                                                scope_)
+                        : call_futex_wait(cnt_, 0, scope_);
+      waiters_.fetch_sub(1, std::memory_order_relaxed);
+      if (try_wait())
+        return t_errn{0};
+      if (get(errn) != 0 && get(errn) != EAGAIN && get(errn) != EINTR)
+        return errn;
+    }
+  }
+
+  t_void t_semaphore::wait_(t_err err, const t_deadline* deadline) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == INVALID) {
+        err = err::E_INVALID_INST;
+        return;
+      }
+      for (t_n_ spin = 0, max = get_spin_max_(SPIN_MAX_); spin < max; ++spin) {
+        if (try_wait())
+          return;
+        relax_cpu();
+      }
+      do {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        if (!cnt_.load(std::memory_order_seq_cst)) {
+          if (deadline)
+            call_futex_wait_until(err, cnt_, 0, to_(deadline->get_time()), scope_);
+          else
+            call_futex_wait(err, cnt_, 0, scope_);
+        }
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+        if (!err && try_wait())
+          return;
+      } while (!err);
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_barrier::t_barrier(t_n parties) noexcept
+    : parties_{static_cast<t_futex_value>(get(parties))} {
+  }
+
+  t_barrier::t_barrier(t_err err, t_n parties) noexcept
+    : parties_{0} {
+    ERR_GUARD(err) {
+      if (get(parties))
+        parties_ = static_cast<t_futex_value>(get(parties));
+      else
+        err = err::E_INIT_FAIL;
+    }
+  }
+
+  t_barrier::~t_barrier() {
+  }
+
+  t_bool t_barrier::arrive_and_wait() noexcept {
+    if (parties_) {
+      t_futex_value phase = phase_.load(std::memory_order_acquire);
+      if (arrived_.fetch_add(1, std::memory_order_acq_rel) + 1 == parties_) {
+        arrived_.store(0, std::memory_order_relaxed);
+        phase_.store(phase + 1, std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_seq_cst))
+          call_futex_wake_all(phase_);
+        return true;
+      }
+      wait_(phase);
+    }
+    return false;
+  }
+
+  t_bool t_barrier::arrive_and_wait(t_err err) noexcept {
+    ERR_GUARD(err) {
+      if (parties_)
+        return arrive_and_wait();
+      err = err::E_INVALID_INST;
+    }
+    return false;
+  }
+
+  t_void t_barrier::wait_(t_futex_value phase) noexcept {
+    for (t_n_ spin = 0, max = get_spin_max_(SPIN_MAX_); spin < max; ++spin) {
+      if (phase_.load(std::memory_order_acquire) != phase)
+        return;
+      relax_cpu();
+    }
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    while (phase_.load(std::memory_order_seq_cst) == phase)
+      call_futex_wait(phase_, phase);
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_latch::t_latch(t_n cnt) noexcept
+    : cnt_{static_cast<t_futex_value>(get(cnt))}, valid_{VALID} {
+  }
+
+  t_latch::t_latch(t_err err, t_n cnt) noexcept
+    : cnt_{static_cast<t_futex_value>(get(cnt))} {
+    ERR_GUARD(err) {
+      valid_ = VALID;
+    }
+  }
+
+  t_latch::~t_latch() {
+  }
+
+  // the count stops at zero, counting down past it is ignored
+  t_void t_latch::count_down(t_n n) noexcept {
+    if (!get(n))
+      return;
+    t_futex_value cnt = cnt_.load(std::memory_order_relaxed), next;
+    do {
+      if (!cnt)
+        return;
+      next = get(n) < cnt ? cnt - static_cast<t_futex_value>(get(n)) : 0;
+    } while (!cnt_.compare_exchange_weak(cnt, next, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed));
+    if (!next && waiters_.load(std::memory_order_seq_cst))
+      call_futex_wake_all(cnt_);
+  }
+
+  t_void t_latch::wait(t_err err) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID) {
+        if (wait_(nullptr) != VALID)
+          err = err::E_XXX;
+      } else
+        err = err::E_INVALID_INST;
+    }
+  }
+
+  t_errn t_latch::wait(t_time time) noexcept {
+    t_deadline deadline{time};
+    return wait_(&deadline);
+  }
+
+  t_void t_latch::wait(t_err err, t_time time) noexcept {
+    ERR_GUARD(err) {
+      t_deadline deadline{err, time};
+      wait(err, deadline);
+    }
+  }
+
+  t_errn t_latch::wait(t_deadline deadline) noexcept {
+    return wait_(&deadline);
+  }
+
+  t_void t_latch::wait(t_err err, t_deadline deadline) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID) {
+        auto errn = wait_(&deadline);
+        if (get(errn) == ETIMEDOUT)
+          err = err::E_TIMEOUT;
+        else if (errn != VALID)
+          err = err::E_XXX;
+      } else
+        err = err::E_INVALID_INST;
+    }
+  }
+
+  t_errn t_latch::arrive_and_wait() noexcept {
+    count_down();
+    return wait_(nullptr);
+  }
+
+  t_void t_latch::arrive_and_wait(t_err err) noexcept {
+    ERR_GUARD(err) {
+      count_down();
+      wait(err);
+    }
+  }
+
+  t_errn t_latch::wait_(const t_deadline* deadline) noexcept {
+    if (valid_ == INVALID)
+      return t_errn{-1};
+    for (t_n_ spin = 0, max = get_spin_max_(SPIN_MAX_); spin < max; ++spin) {
+      if (try_wait())
+        return t_errn{0};
+      relax_cpu();
+    }
+    t_errn errn{0};
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    for (t_futex_value cnt; (cnt = cnt_.load(std::memory_order_seq_cst)); ) {
+      errn = deadline ? call_futex_wait_until(cnt_, cnt, to_(deadline->get_time()))
+                      : call_futex_wait(cnt_, cnt);
+      if (get(errn) == EAGAIN || get(errn) == EINTR)
+        errn = t_errn{0};
+      else if (errn != VALID)
+        break;
+    }
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+    return errn;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  struct t_arena::t_chunk_ {
+    t_chunk_* next_;
+    t_n_      size_;
+
+    named::t_uint8* begin() noexcept {
+      return reinterpret_cast<named::t_uint8*>(this + 1);
+    }
+
+    named::t_uint8* end() noexcept {
+      return reinterpret_cast<named::t_uint8*>(this) + size_;
+    }
+  };
+
+  t_arena::t_arena(t_arena_size size) noexcept
+    : chunk_size_{get(size)} {
+    reset();
+  }
+
+  t_arena::t_arena(t_err err, t_arena_size size) noexcept
+    : chunk_size_{get(size)} {
+    ERR_GUARD(err) {
+      reset();
+      if (!head_)
+        err = err::E_INIT_FAIL;
+    }
+  }
+
+  t_arena::~t_arena() {
+    for (t_chunk_* chunk = head_; chunk; ) {
+      t_chunk_* next = chunk->next_;
+      call_munmap(chunk, t_n{chunk->size_});
+      chunk = next;
+    }
+  }
+
+  p_void t_arena::allocate(t_err err, t_n size) noexcept {
+    ERR_GUARD(err) {
+      p_void ptr = allocate(size);
+      if (ptr)
+        return ptr;
+      err = err::E_XXX;
+    }
+    return nullptr;
+  }
+
+  p_void t_arena::allocate(t_err err, t_n size, t_n align) noexcept {
+    ERR_GUARD(err) {
+      p_void ptr = allocate(size, align);
+      if (ptr)
+        return ptr;
+      err = err::E_XXX;
+    }
+    return nullptr;
+  }
+
+  p_void t_arena::grow_(t_n_ size, t_n_ align) noexcept {
+    t_chunk_* next = cur_ ? cur_->next_ : head_;
+    if (!next || next->begin() + size + align > next->end()) {
+      t_n_ page = get(call_getpagesize());
+      t_n_ need = (sizeof(t_chunk_) + size + align + page - 1) & ~(page - 1);
+      if (need < chunk_size_)
+        need = (chunk_size_ + page - 1) & ~(page - 1);
+      auto verify = call_mmap(t_n{need}, PROT_READ | PROT_WRITE, 0);
+      if (verify != VALID)
+        return nullptr;
+      t_chunk_* chunk = static_cast<t_chunk_*>(verify.value);
+      chunk->size_ = need;
+      chunk->next_ = next;
+      if (cur_)
+        cur_->next_ = chunk;
+      else
+        head_ = chunk;
+      next = chunk;
+    }
+    cur_ = next;
+    ptr_ = next->begin();
+    end_ = next->end();
+    return allocate(t_n{size}, t_n{align});
+  }
+
+  t_void t_arena::reset() noexcept {
+    cur_  = head_;
+    ptr_  = head_ ? head_->begin() : nullptr;
+    end_  = head_ ? head_->end()   : nullptr;
+    used_ = 0;
+    if (!head_ && chunk_size_) {
+      grow_(0, 1);
+      used_ = 0;
+    }
+  }
+
+  t_n t_arena::get_capacity() const noexcept {
+    t_n_ capacity = 0;
+    for (t_chunk_* chunk = head_; chunk; chunk = chunk->next_)
+      capacity += chunk->end() - chunk->begin();
+    return t_n{capacity};
+  }
+
+  t_arena* t_arena::get_thread() noexcept {
+    return thread_arena_;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_thread::t_thread() noexcept {
+  }
+
+  t_thread::t_thread(p_run run, p_void arg) noexcept {
+    create(run, arg);
+  }
+
+  t_thread::t_thread(t_err err, p_run run, p_void arg) noexcept {
+    create(err, run, arg);
+  }
+
+  t_thread::t_thread(p_run run, p_void arg, R_pthread_attr attr) noexcept {
+    create(run, arg, attr);
+  }
+
+  t_thread::t_thread(t_err err, p_run run, p_void arg,
+                     R_pthread_attr attr) noexcept {
+    create(err, run, arg, attr);
+  }
+
+  t_thread::t_thread(p_run run, p_void arg, t_arena_size size) noexcept {
+    create(run, arg, size);
+  }
+
+  t_thread::t_thread(t_err err, p_run run, p_void arg,
+                     t_arena_size size) noexcept {
+    create(err, run, arg, size);
+  }
+
+  t_thread::t_thread(p_run run, p_void arg, R_pthread_attr attr,
+                     t_arena_size size) noexcept {
+    create(run, arg, attr, size);
+  }
+
+  t_thread::t_thread(t_err err, p_run run, p_void arg, R_pthread_attr attr,
+                     t_arena_size size) noexcept {
+    create(err, run, arg, attr, size);
+  }
+
+  t_errn t_thread::map_stack_(r_pthread_attr attr, P_pthread_attr from,
+                              t_stack_size size) noexcept {
+    t_n_ page  = get(call_getpagesize());
+    t_n_ bytes = (get(size) + page - 1) / page * page;
+    auto verify = call_mmap(t_n{bytes + page}, PROT_READ | PROT_WRITE,
+                            MAP_STACK);
+    if (verify == INVALID)
+      return t_errn{-1};
+
+    auto base   = static_cast<named::t_uint8*>(verify.value);
+    stack_      = base;
+    stack_size_ = bytes + page;
+
+    auto errn = call_mprotect(base, t_n{page}, PROT_NONE);
+    if (errn == VALID) {
+      auto touch = static_cast<volatile named::t_uint8*>(base);
+      for (t_n_ offset = page; offset < stack_size_; offset += page)
+        touch[offset] = 0;
+      errn = call_mlock(base + page, t_n{bytes});
+    }
+    if (errn == VALID) {
+      errn = from ? call_pthread_copy(attr, *from) : call_pthread_init(attr);
+      if (errn == VALID) {
+        errn = call_pthread_set_stack(attr, base + page, t_n{bytes});
+        if (errn == INVALID)
+          call_pthread_destroy(attr);
+      }
+    }
+    if (errn == INVALID)
+      unmap_stack_();
+    return errn;
+  }
+
+  t_void t_thread::unmap_stack_() noexcept {
+    if (stack_) {
+      call_munmap(stack_, t_n{stack_size_});
+      stack_      = nullptr;
+      stack_size_ = 0;
+    }
+  }
+
+  t_void t_thread::wait_moved_(t_handoff_& handoff) noexcept {
+    wait_handoff_(handoff.moved);
+  }
+
+  t_void t_thread::notify_moved_(t_handoff_& handoff) noexcept {
+    notify_handoff_(handoff.moved);
+  }
+
+  t_thread::t_thread(p_run run, p_void arg, t_stack_size size) noexcept {
+    create(run, arg, size);
+  }
+
+  t_thread::t_thread(t_err err, p_run run, p_void arg,
+                     t_stack_size size) noexcept {
+    create(err, run, arg, size);
+  }
+
+  t_thread::t_thread(p_run run, p_void arg, R_pthread_attr attr,
+                     t_stack_size size) noexcept {
+    create(run, arg, attr, size);
+  }
+
+  t_thread::t_thread(t_err err, p_run run, p_void arg, R_pthread_attr attr,
+                     t_stack_size size) noexcept {
+    create(err, run, arg, attr, size);
+  }
+
+  // join() unmaps the stack. a thread that could not be joined may still
+  // run on it, so its mapping is left alone.
+  t_thread::~t_thread() {
+    if (valid_ == VALID && join_)
+      join();
+  }
+
+  t_errn t_thread::create(p_run run, p_void arg) noexcept {
+    return create(run, arg, t_arena_size{0});
+  }
+
+  t_void t_thread::create(t_err err, p_run run, p_void arg) noexcept {
+    create(err, run, arg, t_arena_size{0});
+  }
+
+  t_errn t_thread::create(p_run run, p_void arg,
+                          R_pthread_attr attr) noexcept {
+    return create(run, arg, attr, t_arena_size{0});
+  }
+
+  t_void t_thread::create(t_err err, p_run run, p_void arg,
+                          R_pthread_attr attr) noexcept {
+    create(err, run, arg, attr, t_arena_size{0});
+  }
+
+  t_errn t_thread::create(p_run run, p_void arg, t_arena_size size) noexcept {
+    t_errn errn{-1};
+    if (valid_ == INVALID) {
+      t_start_ start{run, arg, size};
+      errn = call_pthread_create(thread_, start_thread_, &start);
+      if (errn == VALID) {
+        wait_started_(start);
+        join_  = true;
+        valid_ = VALID;
+      }
+    }
+    return errn;
+  }
+
+  t_void t_thread::create(t_err err, p_run run, p_void arg,
+                          t_arena_size size) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == INVALID) {
+        t_start_ start{run, arg, size};
+        call_pthread_create(err, thread_, start_thread_, &start);
+        if (!err) {
+          wait_started_(start);
+          join_  = true;
+          valid_ = VALID;
+        }
+      } else
+        err = err::E_VALID_INST;
+    }
+  }
+
+  t_errn t_thread::create(p_run run, p_void arg, R_pthread_attr attr,
+                          t_arena_size size) noexcept {
+    t_errn errn{-1};
+    if (valid_ == INVALID) {
+      t_start_ start{run, arg, size};
+      errn = call_pthread_create(thread_, attr, start_thread_, &start);
+      if (errn == VALID) {
+        wait_started_(start);
+        join_  = !call_pthread_is_detach(attr);
+        valid_ = VALID;
+      }
+    }
+    return errn;
+  }
+
+  t_void t_thread::create(t_err err, p_run run, p_void arg,
+                          R_pthread_attr attr, t_arena_size size) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == INVALID) {
+        t_start_ start{run, arg, size};
+        call_pthread_create(err, thread_, attr, start_thread_, &start);
+        if (!err) {
+          wait_started_(start);
+          join_  = !call_pthread_is_detach(attr);
+          valid_ = VALID;
+        }
+      } else
+        err = err::E_VALID_INST;
+    }
+  }
+
+  t_errn t_thread::create(p_run run, p_void arg, t_stack_size size) noexcept {
+    t_errn errn{-1};
+    if (valid_ == INVALID) {
+      ::pthread_attr_t attr;
+      errn = map_stack_(attr, nullptr, size);
+      if (errn == VALID) {
+        errn = create(run, arg, attr);
+        call_pthread_destroy(attr);
+        if (errn == INVALID)
+          unmap_stack_();
+      }
+    }
+    return errn;
+  }
+
+  t_void t_thread::create(t_err err, p_run run, p_void arg,
+                          t_stack_size size) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == INVALID) {
+        ::pthread_attr_t attr;
+        if (map_stack_(attr, nullptr, size) == VALID) {
+          create(err, run, arg, attr);
+          call_pthread_destroy(attr);
+          if (err)
+            unmap_stack_();
+        } else
+          err = err::E_XXX;
+      } else
+        err = err::E_VALID_INST;
+    }
+  }
+
+  t_errn t_thread::create(p_run run, p_void arg, R_pthread_attr from,
+                          t_stack_size size) noexcept {
+    t_errn errn{-1};
+    if (valid_ == INVALID && !call_pthread_is_detach(from)) {
+      ::pthread_attr_t attr;
+      errn = map_stack_(attr, &from, size);
+      if (errn == VALID) {
+        errn = create(run, arg, attr);
+        call_pthread_destroy(attr);
+        if (errn == INVALID)
+          unmap_stack_();
+      }
+    }
+    return errn;
+  }
+
+  t_void t_thread::create(t_err err, p_run run, p_void arg,
+                          R_pthread_attr from, t_stack_size size) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == INVALID) {
+        ::pthread_attr_t attr;
+        if (!call_pthread_is_detach(from) &&
+            map_stack_(attr, &from, size) == VALID) {
+          create(err, run, arg, attr);
+          call_pthread_destroy(attr);
+          if (err)
+            unmap_stack_();
+        } else
+          err = err::E_XXX;
+      } else
+        err = err::E_VALID_INST;
+    }
+  }
+
+  t_errn t_thread::detach() noexcept {
+    t_errn errn{-1};
+    if (valid_ == VALID && join_ && !stack_) {
+      errn = call_pthread_detach(thread_);
       if (errn == VALID)
+        join_ = false;
+    }
+    return errn;
+  }
+
+  t_void t_thread::detach(t_err err) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID && join_ && !stack_) {
+        call_pthread_detach(err, thread_);
+        if (!err)
+          join_ = false;
+      } else
+        err = err::E_INVALID_INST;
+    }
+  }
+
+  t_errn t_thread::join() noexcept {
+    t_errn errn{-1};
+    if (valid_ == VALID && join_) {
+      errn = call_pthread_join(thread_);
+      if (errn == VALID) {
         valid_ = INVALID;
+        unmap_stack_();
+      }
     }
     return errn;
   }
@@ -775,7 +1804,10 @@ namespace threading
     ERR_GUARD(err) {
       if (valid_ == VALID && join_) {
         call_pthread_join(err, thread_);
-        valid_ = !err ? INVALID : VALID;
+        if (!err) {
+          valid_ = INVALID;
+          unmap_stack_();
+        }
       } else
         err = err::E_INVALID_INST;
     }
@@ -785,8 +1817,10 @@ namespace threading
     t_errn errn{-1};
     if (valid_ == VALID && join_) {
       errn = call_pthread_join(thread_, arg);
-      if (errn == VALID)
+      if (errn == VALID) {
         valid_ = INVALID;
+        unmap_stack_();
+      }
     }
     return errn;
   }
@@ -795,7 +1829,10 @@ namespace threading
     ERR_GUARD(err) {
       if (valid_ == VALID && join_) {
         call_pthread_join(err, thread_, arg);
-        valid_ = !err ? INVALID : VALID;
+        if (!err) {
+          valid_ = INVALID;
+          unmap_stack_();
+        }
       } else
         err = err::E_INVALID_INST;
     }
@@ -896,11 +1933,18 @@ namespace threading
   }
 
   t_errn t_thread::set_name(t_pthread thread, P_cstr name) noexcept {
-    return call_pthread_setname_np(thread, name);
+    auto errn = call_pthread_setname_np(thread, name);
+    if (errn == VALID)
+      t_thread_registry::set_name_(thread, name);
+    return errn;
   }
 
   t_void t_thread::set_name(t_err err, t_pthread thread, P_cstr name) noexcept {
-    call_pthread_setname_np(err, thread, name);
+    ERR_GUARD(err) {
+      call_pthread_setname_np(err, thread, name);
+      if (!err)
+        t_thread_registry::set_name_(thread, name);
+    }
   }
 
   t_errn t_thread::get_name(t_pthread thread, p_cstr name, t_n len) noexcept {
@@ -912,6 +1956,434 @@ namespace threading
     call_pthread_getname_np(err, thread, name, len);
   }
 
+///////////////////////////////////////////////////////////////////////////////
+
+  t_bool t_thread_registry::enter() noexcept {
+    if (!thread_slot_) {
+      for (auto& slot : thread_slots_) {
+        t_bool used = false;
+        if (slot.used.compare_exchange_strong(used, true,
+                                              std::memory_order_acquire)) {
+          char name[16] = {};
+          call_pthread_getname_np(call_pthread_self(), p_cstr{name},
+                                  t_n{sizeof(name)});
+          store_name_(slot, P_cstr{name});
+          slot.thread.store(call_pthread_self(), std::memory_order_relaxed);
+          slot.tid.store(call_gettid(), std::memory_order_release);
+          thread_slot_ = &slot;
+          break;
+        }
+      }
+    }
+    return thread_slot_;
+  }
+
+  t_void t_thread_registry::leave() noexcept {
+    if (thread_slot_) {
+      thread_slot_->tid.store(0, std::memory_order_relaxed);
+      thread_slot_->used.store(false, std::memory_order_release);
+      thread_slot_ = nullptr;
+    }
+  }
+
+  t_n t_thread_registry::get_threads() noexcept {
+    t_n_ n = 0;
+    for (auto& slot : thread_slots_)
+      if (slot.tid.load(std::memory_order_relaxed))
+        ++n;
+    return t_n{n};
+  }
+
+  t_time t_thread_registry::get_cpu_time() noexcept {
+    t_time time;
+    ::timespec spec;
+    if (call_clock_gettime(CLOCK_THREAD_CPUTIME_ID, spec) == VALID)
+      to_(time, spec);
+    return time;
+  }
+
+  t_n t_thread_registry::snapshot(p_thread_stats stats, t_n max) noexcept {
+    t_n_ n = 0;
+    for (auto& slot : thread_slots_) {
+      if (n == get(max))
+        break;
+      t_pid tid = slot.tid.load(std::memory_order_acquire);
+      if (tid) {
+        t_thread_stats& entry = stats[n];
+        entry = t_thread_stats{};
+        entry.tid = tid;
+        load_name_(slot, entry.name);
+        // fails when the thread exited in the meantime
+        ::timespec spec;
+        if (call_clock_gettime(call_thread_cpuclock(tid), spec) == VALID) {
+          to_(entry.cpu_time, spec);
+          ++n;
+        }
+      }
+    }
+    return t_n{n};
+  }
+
+  t_n t_thread_registry::snapshot_sched(p_thread_stats stats,
+                                        t_n max) noexcept {
+    t_n n = snapshot(stats, max);
+    for (t_n_ ix = 0; ix < get(n); ++ix)
+      read_sched_(stats[ix]);
+    return n;
+  }
+
+  t_void t_thread_registry::set_name_(t_pthread thread, P_cstr name) noexcept {
+    for (auto& slot : thread_slots_)
+      if (slot.tid.load(std::memory_order_acquire) &&
+          call_pthread_equal(slot.thread.load(std::memory_order_relaxed),
+                             thread))
+        store_name_(slot, name);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_qsbr::t_qsbr() noexcept {
+  }
+
+  t_qsbr::~t_qsbr() {
+    for (auto node = retired_.load(std::memory_order_acquire); node;) {
+      auto next = node->next_;
+      node->free_(node);
+      node = next;
+    }
+  }
+
+  t_void t_qsbr::retire(t_qsbr_node* node, t_qsbr_node::p_free free) noexcept {
+    node->free_  = free;
+    node->epoch_ = epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+    push_(node, node);
+  }
+
+  t_n t_qsbr::reclaim() noexcept {
+    auto node = retired_.exchange(nullptr, std::memory_order_acquire);
+    if (!node)
+      return t_n{0};
+
+    t_epoch_     min   = get_min_epoch_();
+    t_qsbr_node* first = nullptr;
+    t_qsbr_node* last  = nullptr;
+    t_n_         freed = 0;
+    while (node) {
+      auto next = node->next_;
+      if (node->epoch_ <= min) {
+        node->free_(node);
+        ++freed;
+      } else {
+        node->next_ = first;
+        first       = node;
+        if (!last)
+          last = node;
+      }
+      node = next;
+    }
+    if (first)
+      push_(first, last);
+    return t_n{freed};
+  }
+
+  t_void t_qsbr::synchronize() noexcept {
+    t_epoch_ target = epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (auto& slot : slots_) {
+      if (!slot.used.load(std::memory_order_acquire))
+        continue;
+      for (t_n_ spin = 0;; ++spin) {
+        t_epoch_ epoch = slot.epoch.load(std::memory_order_acquire);
+        if (!epoch || epoch >= target)
+          break;
+        if (spin < 128)
+          relax_cpu();
+        else
+          call_sched_yield();
+      }
+    }
+    reclaim();
+  }
+
+  t_qsbr::t_slot_* t_qsbr::claim_() noexcept {
+    for (auto& slot : slots_) {
+      t_bool used = false;
+      if (slot.used.compare_exchange_strong(used, true,
+                                            std::memory_order_acq_rel))
+        return &slot;
+    }
+    return nullptr;
+  }
+
+  t_qsbr::t_epoch_ t_qsbr::get_min_epoch_() const noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    t_epoch_ min = ~t_epoch_{0};
+    for (auto& slot : slots_) {
+      t_epoch_ epoch = slot.epoch.load(std::memory_order_acquire);
+      if (epoch && epoch < min)
+        min = epoch;
+    }
+    return min;
+  }
+
+  t_void t_qsbr::push_(t_qsbr_node* first, t_qsbr_node* last) noexcept {
+    auto head = retired_.load(std::memory_order_relaxed);
+    do {
+      last->next_ = head;
+    } while (!retired_.compare_exchange_weak(head, first,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_qsbr_reader::t_qsbr_reader(t_qsbr& qsbr) noexcept
+    : qsbr_(qsbr), slot_{qsbr.claim_()} {
+    if (slot_)
+      online();
+  }
+
+  t_qsbr_reader::t_qsbr_reader(t_err err, t_qsbr& qsbr) noexcept
+    : qsbr_(qsbr), slot_{nullptr} {
+    ERR_GUARD(err) {
+      slot_ = qsbr.claim_();
+      if (slot_)
+        online();
+      else
+        err = err::E_XXX;
+    }
+  }
+
+  t_qsbr_reader::~t_qsbr_reader() {
+    if (slot_) {
+      offline();
+      slot_->used.store(false, std::memory_order_release);
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(__x86_64__)
+  namespace
+  {
+    thread_local t_fiber_scheduler* fiber_scheduler_ = nullptr;
+  }
+
+  t_fiber_scheduler::t_fiber_scheduler(t_stack_size size) noexcept {
+    t_n_ page   = get(call_getpagesize());
+    stack_size_ = (get(size) + page - 1) / page * page;
+    map_size_   = stack_size_ + page;
+    if (epoll_ == VALID && stack_size_)
+      valid_ = VALID;
+  }
+
+  t_fiber_scheduler::t_fiber_scheduler(t_err err, t_stack_size size) noexcept
+      : epoll_{err} {
+    ERR_GUARD(err) {
+      t_n_ page   = get(call_getpagesize());
+      stack_size_ = (get(size) + page - 1) / page * page;
+      map_size_   = stack_size_ + page;
+      if (stack_size_)
+        valid_ = VALID;
+      else
+        err = err::E_INIT_FAIL;
+    }
+  }
+
+  t_fiber_scheduler::~t_fiber_scheduler() {
+    while (fibers_) {
+      auto fiber = fibers_;
+      fibers_    = fiber->next_fiber;
+      fiber->destroy(fiber->store);
+      call_munmap(fiber->stack, t_n{map_size_});
+    }
+    while (free_) {
+      p_void stack = alloc_stack_();
+      call_munmap(stack, t_n{map_size_});
+    }
+  }
+
+  t_fiber_scheduler* t_fiber_scheduler::get_current() noexcept {
+    return fiber_scheduler_;
+  }
+
+  t_errn t_fiber_scheduler::run() noexcept {
+    if (valid_ == INVALID || fiber_scheduler_)
+      return t_errn{-1};
+
+    fiber_scheduler_ = this;
+    fdbased::t_epoll::t_event events[64];
+    while (live_) {
+      while (head_) {
+        current_ = head_;
+        head_    = current_->next;
+        if (!head_)
+          tail_ = nullptr;
+        current_->next = nullptr;
+        dainty_os_fiber_switch_(&sp_, current_->sp);
+        if (current_->done) {
+          if (current_->prev_fiber)
+            current_->prev_fiber->next_fiber = current_->next_fiber;
+          else
+            fibers_ = current_->next_fiber;
+          if (current_->next_fiber)
+            current_->next_fiber->prev_fiber = current_->prev_fiber;
+          free_stack_(current_->stack);
+          --live_;
+        }
+        current_ = nullptr;
+      }
+      if (live_) {
+        auto verify = epoll_.wait(events);
+        if (verify == VALID) {
+          for (t_n_ ix = 0; ix < get(verify.value); ++ix) {
+            auto fiber    = static_cast<p_fiber_>(events[ix].data.ptr);
+            fiber->events = events[ix].events;
+            ready_(fiber);
+          }
+        }
+      }
+    }
+    fiber_scheduler_ = nullptr;
+    return t_errn{0};
+  }
+
+  t_void t_fiber_scheduler::run(t_err err) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID) {
+        if (run() == INVALID)
+          err = err::E_XXX;
+      } else
+        err = err::E_INVALID_INST;
+    }
+  }
+
+  t_void t_fiber_scheduler::yield() noexcept {
+    if (current_) {
+      ready_(current_);
+      suspend_();
+    }
+  }
+
+  t_errn t_fiber_scheduler::read(fdbased::r_eventfd eventfd,
+                                 fdbased::t_eventfd::r_value value) noexcept {
+    auto errn = wait_readable(eventfd.get_fd());
+    if (errn == VALID)
+      errn = eventfd.read(value);
+    return errn;
+  }
+
+  t_errn t_fiber_scheduler::read(fdbased::r_timerfd timerfd,
+                                 fdbased::t_timerfd::r_data data) noexcept {
+    auto errn = wait_readable(timerfd.get_fd());
+    if (errn == VALID)
+      errn = timerfd.read(data);
+    return errn;
+  }
+
+  t_errn t_fiber_scheduler::wait_(t_fd fd, t_event_mask mask) noexcept {
+    if (!current_)
+      return t_errn{-1};
+    fdbased::t_epoll::t_event_data data;
+    data.ptr  = current_;
+    auto errn = epoll_.add_event(fd, mask | EPOLLONESHOT, data);
+    if (errn == VALID) {
+      suspend_();
+      epoll_.del_event(fd);
+    } else if (errno == EEXIST)
+      errn = t_errn{EBUSY}; // another fiber waits on fd
+    return errn;
+  }
+
+  t_void t_fiber_scheduler::ready_(p_fiber_ fiber) noexcept {
+    fiber->next = nullptr;
+    if (tail_)
+      tail_->next = fiber;
+    else
+      head_ = fiber;
+    tail_ = fiber;
+  }
+
+  t_void t_fiber_scheduler::suspend_() noexcept {
+    dainty_os_fiber_switch_(&current_->sp, sp_);
+  }
+
+  // the fiber and its callable live at the top of its own stack
+  t_fiber_scheduler::p_fiber_
+      t_fiber_scheduler::create_(t_n_ size, t_n_ align) noexcept {
+    if (valid_ == INVALID || size > stack_size_ / 4)
+      return nullptr;
+    p_void stack = alloc_stack_();
+    if (!stack)
+      return nullptr;
+
+    ::uintptr_t top   = reinterpret_cast<::uintptr_t>(stack) + map_size_;
+    ::uintptr_t at    = (top - sizeof(t_fiber_)) & ~::uintptr_t(15);
+    auto        fiber = new (reinterpret_cast<p_void>(at)) t_fiber_;
+    fiber->sched = this;
+    fiber->stack = stack;
+    fiber->store = reinterpret_cast<p_void>((at - size) & ~(align - 1));
+    return fiber;
+  }
+
+  // initial frame as dainty_os_fiber_switch_ leaves it: x87/mxcsr, r15,
+  // r14, r13 = main_, r12 = fiber, rbx, rbp, return to the start stub
+  t_void t_fiber_scheduler::start_(p_fiber_ fiber) noexcept {
+    auto top   = reinterpret_cast<::uintptr_t>(fiber->store) & ~::uintptr_t(15);
+    auto frame = reinterpret_cast<named::t_uint64*>(top - 9 * 8);
+    frame[0] = 0x037f;
+    frame[1] = 0x1f80;
+    frame[2] = 0;
+    frame[3] = 0;
+    frame[4] = reinterpret_cast<named::t_uint64>(&main_);
+    frame[5] = reinterpret_cast<named::t_uint64>(fiber);
+    frame[6] = 0;
+    frame[7] = 0;
+    frame[8] = reinterpret_cast<named::t_uint64>(&dainty_os_fiber_start_);
+    fiber->sp = frame;
+    fiber->next_fiber = fibers_;
+    if (fibers_)
+      fibers_->prev_fiber = fiber;
+    fibers_ = fiber;
+    ++live_;
+    ready_(fiber);
+  }
+
+  t_void t_fiber_scheduler::main_(p_void ptr) noexcept {
+    auto fiber = static_cast<p_fiber_>(ptr);
+    fiber->run(fiber->store);
+    fiber->destroy(fiber->store);
+    fiber->done = true;
+    dainty_os_fiber_switch_(&fiber->sp, fiber->sched->sp_);
+  }
+
+  // free stacks are linked through the lowest word above the guard page
+  p_void t_fiber_scheduler::alloc_stack_() noexcept {
+    if (free_) {
+      p_void stack = free_;
+      free_ = *reinterpret_cast<p_void*>(static_cast<named::t_uint8*>(stack) +
+                                         (map_size_ - stack_size_));
+      return stack;
+    }
+    auto verify = call_mmap(t_n{map_size_}, PROT_READ | PROT_WRITE,
+                            MAP_STACK | MAP_NORESERVE);
+    if (verify == INVALID)
+      return nullptr;
+    if (call_mprotect(verify.value, t_n{map_size_ - stack_size_},
+                      PROT_NONE) == INVALID) {
+      call_munmap(verify.value, t_n{map_size_});
+      return nullptr;
+    }
+    return verify.value;
+  }
+
+  t_void t_fiber_scheduler::free_stack_(p_void stack) noexcept {
+    *reinterpret_cast<p_void*>(static_cast<named::t_uint8*>(stack) +
+                               (map_size_ - stack_size_)) = free_;
+    free_ = stack;
+  }
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
@@ -27,8 +27,18 @@
 #ifndef _DAINTY_OS_THREADING_H_
 #define _DAINTY_OS_THREADING_H_
 
+#include <errno.h>
+#include <stdint.h>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <atomic>
+#include <limits>
+#include <new>
+#include <utility>
 #include "dainty_os_call.h"
 #include "dainty_os_clock.h"
+#include "dainty_os_fdbased.h"
 
 namespace dainty
 {
@@ -41,12 +51,51 @@ namespace threading
   using named::t_bool;
   using named::t_int;
   using named::t_validity;
+  using named::t_n_;
   using named::t_n;
   using named::p_cstr;
   using named::P_cstr;
   using named::VALID;
   using named::INVALID;
   using clock::t_time;
+  using clock::t_deadline;
+
+  constexpr t_n_ CACHE_LINE_SIZE = 64;
+
+  inline t_void relax_cpu() noexcept {
+#if (defined(__i386__) || defined(__x86_64__))
+    __builtin_ia32_pause();
+#elif (defined(__aarch64__))
+    asm volatile("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+  }
+
+  // spin limit of a waiter before it sleeps. on a single cpu there is no
+  // spinning, it would only keep the awaited thread from running.
+  t_n_ get_spin_max_(t_n_ max) noexcept;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // asymmetric fences, for a hot side that runs all the time paired with a
+  // cold side that runs rarely, e.g. polling a stop flag or publishing a
+  // hazard pointer against the scan. once registered light_fence() is only
+  // a compiler barrier and heavy_fence() makes every running thread of the
+  // process execute a full barrier, membarrier(PRIVATE_EXPEDITED). when
+  // registration failed both are full fences.
+  //
+  // registration is done when the library is loaded. an explicit call must
+  // happen before any thread uses the fences.
+  t_errn register_fences()      noexcept;
+  t_void register_fences(t_err) noexcept;
+
+  t_bool has_heavy_fence() noexcept;
+
+  t_void light_fence() noexcept;
+
+  t_errn heavy_fence()      noexcept;
+  t_void heavy_fence(t_err) noexcept;
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -76,6 +125,25 @@ namespace threading
 
 ///////////////////////////////////////////////////////////////////////////////
 
+  enum t_mutex_protocol { MUTEX_PRIO_NONE, MUTEX_PRIO_INHERIT,
+                          MUTEX_PRIO_PROTECT };
+
+  // ceiling is only used with MUTEX_PRIO_PROTECT
+  struct t_mutex_params {
+    t_mutex_protocol protocol = MUTEX_PRIO_NONE;
+    t_int            ceiling  = 0;
+    t_bool           robust   = false;
+    t_process_scope  scope    = PROCESS_PRIVATE;
+  };
+  using R_mutex_params = named::t_prefix<t_mutex_params>::R_;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // robust mutex: when the previous owner died the mutex is still taken and
+  // is_owner_dead() holds. the t_errn variants return EOWNERDEAD, the t_err
+  // variants leave err untouched; cond var waits do the same. repair the
+  // state and call make_consistent() before the scope ends, otherwise the
+  // mutex becomes unrecoverable.
   class t_mutex_lock {
   public:
     using t_locked_scope = threading::t_locked_scope<t_mutex_lock>;
@@ -84,6 +152,8 @@ namespace threading
     t_mutex_lock(t_err err) noexcept;
     t_mutex_lock(           R_pthread_mutexattr) noexcept;
     t_mutex_lock(t_err err, R_pthread_mutexattr) noexcept;
+    t_mutex_lock(           R_mutex_params) noexcept;
+    t_mutex_lock(t_err err, R_mutex_params) noexcept;
     ~t_mutex_lock();
 
     t_mutex_lock(const t_mutex_lock&)            = delete;
@@ -99,9 +169,18 @@ namespace threading
     t_locked_scope make_locked_scope(       t_time) noexcept;
     t_locked_scope make_locked_scope(t_err, t_time) noexcept;
 
+    t_locked_scope make_locked_scope(       t_deadline) noexcept;
+    t_locked_scope make_locked_scope(t_err, t_deadline) noexcept;
+
     t_locked_scope trymake_locked_scope()      noexcept;
     t_locked_scope trymake_locked_scope(t_err) noexcept;
 
+    // only while the mutex is held
+    t_bool is_owner_dead() const noexcept;
+
+    t_errn make_consistent()      noexcept;
+    t_void make_consistent(t_err) noexcept;
+
   private:
     template<typename> friend class threading::t_locked_scope;
     friend class t_cond_var;
@@ -109,8 +188,15 @@ namespace threading
     t_void enter_scope_(t_locked_scope*) noexcept;
     t_void leave_scope_(t_locked_scope*) noexcept;
 
+    t_locked_scope locked_(       t_errn) noexcept;
+    t_locked_scope locked_(t_err, t_errn) noexcept;
+
+    t_errn mark_(       t_errn) noexcept;
+    t_errn mark_(t_err, t_errn) noexcept;
+
     t_pthread_mutex mutex_;
     t_validity      valid_ = INVALID;
+    t_bool          dead_  = false;
   };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -138,6 +224,9 @@ namespace threading
     t_locked_scope make_locked_scope(       t_time) noexcept;
     t_locked_scope make_locked_scope(t_err, t_time) noexcept;
 
+    t_locked_scope make_locked_scope(       t_deadline) noexcept;
+    t_locked_scope make_locked_scope(t_err, t_deadline) noexcept;
+
     t_locked_scope trymake_locked_scope()      noexcept;
     t_locked_scope trymake_locked_scope(t_err) noexcept;
 
@@ -148,10 +237,54 @@ namespace threading
     t_void enter_scope_(t_locked_scope*) noexcept;
     t_void leave_scope_(t_locked_scope*) noexcept;
 
+    t_errn mark_(       t_errn) noexcept;
+    t_errn mark_(t_err, t_errn) noexcept;
+
     t_pthread_mutex mutex_;
     t_validity      valid_ = INVALID;
   };
 
+///////////////////////////////////////////////////////////////////////////////
+
+  struct t_spin_stats {
+    named::t_uint64 spins     = 0; // spin phases entered
+    named::t_uint64 spin_hits = 0; // pred held before the budget ran out
+    named::t_uint64 parks     = 0; // waits that went to sleep after all
+    t_n_            budget    = 0; // current spin budget, in relax_cpu()s
+  };
+
+  // adaptive spin budget shared by the waiters of one condition variable.
+  // a hit moves the budget towards twice the spins it needed, a miss halves
+  // it. there is no spinning on a single cpu.
+  class t_spin_park_ {
+  public:
+    constexpr static t_n_ SPIN_MIN = 16;
+    constexpr static t_n_ SPIN_MAX = 4096;
+
+    // releases the mutex while pred is polled and takes it again. with a
+    // deadline the spin also ends once it expires, the clock is read every
+    // CLOCK_SPINS. a spin cut short by the deadline leaves the budget alone.
+    constexpr static t_n_ CLOCK_SPINS = 64;
+
+    template<typename P>
+    t_errn spin(r_pthread_mutex, P&) noexcept;
+    template<typename P>
+    t_errn spin(r_pthread_mutex, P&, const t_deadline&) noexcept;
+    t_void parked() noexcept;
+
+    t_spin_stats get_stats() const noexcept;
+
+  private:
+    template<typename P>
+    t_errn spin_(r_pthread_mutex, P&, const t_deadline*) noexcept;
+    t_void adapt_(t_n_ budget, t_n_ spun, t_bool hit) noexcept;
+
+    std::atomic<t_n_>            budget_{SPIN_MIN * 8};
+    std::atomic<named::t_uint64> spins_{0};
+    std::atomic<named::t_uint64> hits_{0};
+    std::atomic<named::t_uint64> parks_{0};
+  };
+
 ///////////////////////////////////////////////////////////////////////////////
 
   class t_cond_var {
@@ -187,6 +320,17 @@ namespace threading
     t_errn wait_until(       t_recursive_mutex_lock&, t_time) noexcept;
     t_void wait_until(t_err, t_recursive_mutex_lock&, t_time) noexcept;
 
+    // wait until pred() holds. pred is first polled for an adaptive number
+    // of iterations with the lock released and only then does the waiter
+    // park. pred is read without the lock during the spin, so it may only
+    // look at atomics, which the signaller still changes under the lock.
+    template<typename L, typename P>
+    t_errn spin_wait(       L&, P pred) noexcept;
+    template<typename L, typename P>
+    t_void spin_wait(t_err, L&, P pred) noexcept;
+
+    t_spin_stats get_spin_stats() const noexcept;
+
   private:
     t_errn wait_(       r_pthread_mutex) noexcept;
     t_void wait_(t_err, r_pthread_mutex) noexcept;
@@ -196,6 +340,7 @@ namespace threading
 
     t_pthread_cond cond_;
     t_validity     valid_ = INVALID;
+    t_spin_park_   spin_;
   };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -227,12 +372,47 @@ namespace threading
     t_errn wait_for(       t_mutex_lock&, t_time) noexcept;
     t_void wait_for(t_err, t_mutex_lock&, t_time) noexcept;
 
+    t_errn wait_until(       t_mutex_lock&, t_deadline) noexcept;
+    t_void wait_until(t_err, t_mutex_lock&, t_deadline) noexcept;
+
     t_errn wait(       t_recursive_mutex_lock&) noexcept;
     t_void wait(t_err, t_recursive_mutex_lock&) noexcept;
 
     t_errn wait_for(       t_recursive_mutex_lock&, t_time) noexcept;
     t_void wait_for(t_err, t_recursive_mutex_lock&, t_time) noexcept;
 
+    t_errn wait_until(       t_recursive_mutex_lock&, t_deadline) noexcept;
+    t_void wait_until(t_err, t_recursive_mutex_lock&, t_deadline) noexcept;
+
+    // wait until pred() holds. the deadline is fixed once, so spurious
+    // wakeups and re-checks do not extend the budget. returns pred().
+    template<typename L, typename P>
+    t_bool wait_until(       L&, t_deadline, P pred) noexcept;
+    template<typename L, typename P>
+    t_bool wait_until(t_err, L&, t_deadline, P pred) noexcept;
+
+    template<typename L, typename P>
+    t_bool wait_for(       L&, t_time, P pred) noexcept;
+    template<typename L, typename P>
+    t_bool wait_for(t_err, L&, t_time, P pred) noexcept;
+
+    // wait until pred() holds. pred is first polled for an adaptive number
+    // of iterations with the lock released and only then does the waiter
+    // park. pred is read without the lock during the spin, so it may only
+    // look at atomics, which the signaller still changes under the lock.
+    template<typename L, typename P>
+    t_errn spin_wait(       L&, P pred) noexcept;
+    template<typename L, typename P>
+    t_void spin_wait(t_err, L&, P pred) noexcept;
+
+    // as spin_wait, the spin ends at the deadline too
+    template<typename L, typename P>
+    t_bool spin_wait_until(       L&, t_deadline, P pred) noexcept;
+    template<typename L, typename P>
+    t_bool spin_wait_until(t_err, L&, t_deadline, P pred) noexcept;
+
+    t_spin_stats get_spin_stats() const noexcept;
+
   private:
     t_errn wait_(       r_pthread_mutex) noexcept;
     t_void wait_(t_err, r_pthread_mutex) noexcept;
@@ -240,8 +420,12 @@ namespace threading
     t_errn wait_for_(       r_pthread_mutex, t_time) noexcept;
     t_void wait_for_(t_err, r_pthread_mutex, t_time) noexcept;
 
+    t_errn wait_until_(       r_pthread_mutex, t_deadline) noexcept;
+    t_void wait_until_(t_err, r_pthread_mutex, t_deadline) noexcept;
+
     t_pthread_cond cond_;
     t_validity     valid_ = INVALID;
+    t_spin_park_   spin_;
   };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -265,6 +449,9 @@ namespace threading
     t_locked_scope make_locked_scope(       t_time) noexcept;
     t_locked_scope make_locked_scope(t_err, t_time) noexcept;
 
+    t_locked_scope make_locked_scope(       t_deadline) noexcept;
+    t_locked_scope make_locked_scope(t_err, t_deadline) noexcept;
+
   private:
     template<typename> friend class threading::t_locked_scope;
     t_void enter_scope_(t_locked_scope*) noexcept;
@@ -278,6 +465,144 @@ namespace threading
 
 ///////////////////////////////////////////////////////////////////////////////
 
+  enum  t_arena_size_tag_ {};
+  using t_arena_size = named::t_explicit<t_n_, t_arena_size_tag_>;
+
+  // bump allocator over mmap'd chunks. memory is only given back with
+  // reset(), which rewinds to the first chunk but keeps every chunk for the
+  // next round, or when the arena is destroyed. objects placed in the arena
+  // are not destructed.
+  class t_arena {
+  public:
+     t_arena(       t_arena_size) noexcept;
+     t_arena(t_err, t_arena_size) noexcept;
+    ~t_arena();
+
+    t_arena(const t_arena&)            = delete;
+    t_arena(t_arena&&)                 = delete;
+    t_arena& operator=(const t_arena&) = delete;
+    t_arena& operator=(t_arena&&)      = delete;
+
+    operator t_validity() const noexcept;
+
+    p_void allocate(       t_n size) noexcept;
+    p_void allocate(t_err, t_n size) noexcept;
+    // align must be a power of two, otherwise nothing is allocated
+    p_void allocate(       t_n size, t_n align) noexcept;
+    p_void allocate(t_err, t_n size, t_n align) noexcept;
+
+    template<typename T, typename... Args>
+    T* make(Args&&...) noexcept;
+
+    t_void reset() noexcept;
+
+    t_n get_used()     const noexcept;
+    t_n get_capacity() const noexcept;
+
+    // arena of the calling t_thread, if it was created with one
+    static t_arena* get_thread() noexcept;
+
+  private:
+    struct t_chunk_;
+    p_void grow_(t_n_ size, t_n_ align) noexcept;
+
+    t_n_       chunk_size_ = 0;
+    t_chunk_*  head_       = nullptr;
+    t_chunk_*  cur_        = nullptr;
+    named::t_uint8* ptr_   = nullptr;
+    named::t_uint8* end_   = nullptr;
+    t_n_       used_       = 0;
+  };
+
+  using r_arena = named::t_prefix<t_arena>::r_;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // size class allocator on top of an arena. blocks up to MAX_BLOCK bytes
+  // are recycled through per size class free lists; larger blocks come
+  // straight from the arena. reset() must accompany a reset of the arena.
+  class t_arena_slab {
+  public:
+    enum : t_n_ { MIN_BLOCK = 16, MAX_BLOCK = 4096 };
+
+    t_arena_slab(r_arena) noexcept;
+
+    t_arena_slab(const t_arena_slab&)            = delete;
+    t_arena_slab(t_arena_slab&&)                 = delete;
+    t_arena_slab& operator=(const t_arena_slab&) = delete;
+    t_arena_slab& operator=(t_arena_slab&&)      = delete;
+
+    p_void allocate(t_n size)           noexcept;
+    t_void deallocate(p_void, t_n size) noexcept;
+
+    t_void reset() noexcept;
+
+  private:
+    enum : t_n_ { CLASSES_ = 9 };
+
+    struct t_free_ { t_free_* next_; };
+
+    static t_n_ class_of_(t_n_ size) noexcept;
+
+    r_arena  arena_;
+    t_free_* free_[CLASSES_] = {};
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  struct t_thread_stats {
+    t_pid           tid         = 0;
+    char            name[16]    = {};
+    t_time          cpu_time;          // CLOCK_THREAD_CPUTIME_ID
+    named::t_uint64 voluntary   = 0;   // switches because it blocked
+    named::t_uint64 involuntary = 0;   // switches because it was preempted
+    t_time          run_delay;         // time runnable but waiting for a cpu
+    named::t_uint64 timeslices  = 0;
+  };
+  using p_thread_stats = named::t_prefix<t_thread_stats>::p_;
+
+  // threads started by t_thread register themselves here for their lifetime.
+  // other threads, e.g. main, can do so with a t_scope.
+  class t_thread_registry {
+  public:
+    constexpr static t_n_ THREADS_MAX = 256;
+
+    class t_scope {
+    public:
+       t_scope() noexcept { enter(); }
+      ~t_scope()          { leave(); }
+
+      t_scope(const t_scope&)            = delete;
+      t_scope& operator=(const t_scope&) = delete;
+    };
+
+    // false when all slots are taken
+    static t_bool enter() noexcept;
+    static t_void leave() noexcept;
+
+    static t_n get_threads() noexcept;
+
+    // of the calling thread
+    static t_time get_cpu_time() noexcept;
+
+    // tid, name and cpu time: one clock_gettime per thread and no /proc
+    // reads, cheap enough to poll from a watchdog.
+    static t_n snapshot(p_thread_stats, t_n max) noexcept;
+
+    // also the context switches and schedstat run delay, read from
+    // /proc/self/task/<tid>.
+    static t_n snapshot_sched(p_thread_stats, t_n max) noexcept;
+
+  private:
+    friend class t_thread;
+    static t_void set_name_(t_pthread, P_cstr) noexcept;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  enum  t_stack_size_tag_ {};
+  using t_stack_size = named::t_explicit<t_n_, t_stack_size_tag_>;
+
   class t_thread {
   public:
      t_thread() noexcept;
@@ -285,8 +610,40 @@ namespace threading
      t_thread(t_err, p_run, p_void) noexcept;
      t_thread(       p_run, p_void, R_pthread_attr) noexcept;
      t_thread(t_err, p_run, p_void, R_pthread_attr) noexcept;
+     t_thread(       p_run, p_void, t_arena_size) noexcept;
+     t_thread(t_err, p_run, p_void, t_arena_size) noexcept;
+     t_thread(       p_run, p_void, R_pthread_attr, t_arena_size) noexcept;
+     t_thread(t_err, p_run, p_void, R_pthread_attr, t_arena_size) noexcept;
+     t_thread(       p_run, p_void, t_stack_size) noexcept;
+     t_thread(t_err, p_run, p_void, t_stack_size) noexcept;
+     t_thread(       p_run, p_void, R_pthread_attr, t_stack_size) noexcept;
+     t_thread(t_err, p_run, p_void, R_pthread_attr, t_stack_size) noexcept;
     ~t_thread();
 
+    // callable state is limited to CALLABLE_MAX bytes
+    constexpr static t_n_ CALLABLE_MAX = 256;
+
+    template<typename F>
+    using t_callable_ = typename std::enable_if<
+      std::is_invocable<typename std::decay<F>::type&>::value>::type;
+
+    template<typename F, typename = t_callable_<F>>
+     t_thread(       F&&) noexcept;
+    template<typename F, typename = t_callable_<F>>
+     t_thread(t_err, F&&) noexcept;
+    template<typename F, typename = t_callable_<F>>
+     t_thread(       F&&, R_pthread_attr) noexcept;
+    template<typename F, typename = t_callable_<F>>
+     t_thread(t_err, F&&, R_pthread_attr) noexcept;
+    template<typename F, typename = t_callable_<F>>
+     t_thread(       F&&, t_stack_size) noexcept;
+    template<typename F, typename = t_callable_<F>>
+     t_thread(t_err, F&&, t_stack_size) noexcept;
+    template<typename F, typename = t_callable_<F>>
+     t_thread(       F&&, R_pthread_attr, t_stack_size) noexcept;
+    template<typename F, typename = t_callable_<F>>
+     t_thread(t_err, F&&, R_pthread_attr, t_stack_size) noexcept;
+
     t_thread(const t_thread&)            = delete;
     t_thread(t_thread&&)                 = delete;
     t_thread& operator=(const t_thread&) = delete;
@@ -302,6 +659,46 @@ namespace threading
     t_errn create(       p_run, p_void, R_pthread_attr) noexcept;
     t_void create(t_err, p_run, p_void, R_pthread_attr) noexcept;
 
+    // the thread owns a t_arena for its lifetime, see t_arena::get_thread()
+    t_errn create(       p_run, p_void, t_arena_size) noexcept;
+    t_void create(t_err, p_run, p_void, t_arena_size) noexcept;
+
+    t_errn create(       p_run, p_void, R_pthread_attr, t_arena_size) noexcept;
+    t_void create(t_err, p_run, p_void, R_pthread_attr, t_arena_size) noexcept;
+
+    // the callable is moved onto the new thread's stack before it starts,
+    // no heap allocation. the creator waits until the move is done. const
+    // and lvalue callables are copied, functions are passed as a pointer.
+    template<typename F, typename = t_callable_<F>>
+    t_errn create(       F&&) noexcept;
+    template<typename F, typename = t_callable_<F>>
+    t_void create(t_err, F&&) noexcept;
+
+    template<typename F, typename = t_callable_<F>>
+    t_errn create(       F&&, R_pthread_attr) noexcept;
+    template<typename F, typename = t_callable_<F>>
+    t_void create(t_err, F&&, R_pthread_attr) noexcept;
+
+    // the stack is mapped up front with a guard page below it, pre-faulted
+    // and mlock'ed. it is unmapped after join, so the thread cannot detach.
+    // with an attr its scheduling and affinity settings are used for the
+    // thread, the attr itself is not changed. it must not be detached.
+    t_errn create(       p_run, p_void, t_stack_size) noexcept;
+    t_void create(t_err, p_run, p_void, t_stack_size) noexcept;
+
+    t_errn create(       p_run, p_void, R_pthread_attr, t_stack_size) noexcept;
+    t_void create(t_err, p_run, p_void, R_pthread_attr, t_stack_size) noexcept;
+
+    template<typename F, typename = t_callable_<F>>
+    t_errn create(       F&&, t_stack_size) noexcept;
+    template<typename F, typename = t_callable_<F>>
+    t_void create(t_err, F&&, t_stack_size) noexcept;
+
+    template<typename F, typename = t_callable_<F>>
+    t_errn create(       F&&, R_pthread_attr, t_stack_size) noexcept;
+    template<typename F, typename = t_callable_<F>>
+    t_void create(t_err, F&&, R_pthread_attr, t_stack_size) noexcept;
+
     t_errn detach()      noexcept;
     t_void detach(t_err) noexcept;
 
@@ -337,183 +734,2121 @@ namespace threading
     static t_void get_name(t_err, t_pthread, p_cstr, t_n) noexcept;
 
   private:
+    struct t_handoff_ {
+      const void* callable;
+      t_futex     moved{0};
+    };
+
+    // a function is handed over as a function pointer on the creator's
+    // stack, anything else by reference
+    template<typename F>
+    using t_source_ = typename std::conditional<
+      std::is_function<typename std::remove_reference<F>::type>::value,
+      typename std::decay<F>::type, F&&>::type;
+    static t_void wait_moved_  (t_handoff_&) noexcept;
+    static t_void notify_moved_(t_handoff_&) noexcept;
+
+    template<typename F>
+    static p_void start_(p_void) noexcept;
+
+    // attr is initialised from from, or with defaults when it is nullptr
+    t_errn map_stack_(r_pthread_attr, P_pthread_attr from,
+                      t_stack_size) noexcept;
+    t_void unmap_stack_() noexcept;
+
     t_pthread   thread_;
-    t_validity  valid_ = INVALID;
-    t_bool      join_  = true;
+    t_validity  valid_      = INVALID;
+    t_bool      join_       = true;
+    p_void      stack_      = nullptr;
+    t_n_        stack_size_ = 0;
   };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-  template<typename L>
-  inline t_locked_scope<L>::operator t_validity() const noexcept {
-    return lock_ ? VALID : INVALID;
-  }
+  // single producer, single consumer ring. the producer and consumer indices
+  // live on their own cache lines and each side keeps a cached copy of the
+  // other side's index so it only touches the remote line when it must.
+  //
+  // when constructed with an eventfd the consumer can sit in an epoll loop:
+  // it calls park() before it goes to sleep and the producer writes the
+  // eventfd only when the consumer is parked.
+  template<typename T, t_n_ N>
+  class t_spsc_ring {
+    static_assert(N && !(N & (N - 1)), "N must be a power of 2");
+  public:
+    using t_value = T;
+    using p_value = typename named::t_prefix<T>::p_;
+    using P_value = typename named::t_prefix<T>::P_;
+    using r_value = typename named::t_prefix<T>::r_;
+    using R_value = typename named::t_prefix<T>::R_;
+    using x_value = typename named::t_prefix<T>::x_;
 
-  template<typename L>
-  inline
-  t_locked_scope<L>::t_locked_scope(p_lock lock) noexcept
-    : lock_(lock) {
-  }
+    t_spsc_ring()                   noexcept;
+    t_spsc_ring(fdbased::r_eventfd) noexcept;
 
-  template<typename L>
-  inline
-  typename t_locked_scope<L>::p_lock
-    t_locked_scope<L>::swap_(p_lock lock) noexcept {
-    p_lock tmp = lock_;
-    lock_ = lock;
-    return tmp;
-  }
+    t_spsc_ring(const t_spsc_ring&)            = delete;
+    t_spsc_ring(t_spsc_ring&&)                 = delete;
+    t_spsc_ring& operator=(const t_spsc_ring&) = delete;
+    t_spsc_ring& operator=(t_spsc_ring&&)      = delete;
 
-  template<typename L>
-  inline
-  t_locked_scope<L>::t_locked_scope(t_locked_scope&& scope) noexcept
-    : lock_(scope.swap_(nullptr)) {
-    if (lock_)
-      lock_->enter_scope_(this);
-  }
+    t_n    get_capacity() const noexcept;
+    t_bool is_empty()     const noexcept;
 
-  template<typename L>
-  inline
-  t_locked_scope<L>::~t_locked_scope() {
-    if (lock_)
-      lock_->leave_scope_(this);
-  }
+    // producer side
+    t_bool push(R_value)      noexcept;
+    t_bool push(x_value)      noexcept;
+    t_n    push(P_value, t_n) noexcept;
 
-///////////////////////////////////////////////////////////////////////////////
+    // consumer side
+    t_bool pop(r_value)      noexcept;
+    t_n    pop(p_value, t_n) noexcept;
 
-  inline
-  t_mutex_lock::operator t_validity() const noexcept {
-    return valid_;
-  }
+    t_bool park()   noexcept;
+    t_void unpark() noexcept;
+
+  private:
+    using t_ix_ = named::t_uint64;
+
+    t_bool reserve_(t_ix_, t_n_) noexcept;
+    t_void publish_(t_ix_)       noexcept;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<t_ix_> head_{0};
+    t_ix_                                       tail_cache_ = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<t_ix_> tail_{0};
+    t_ix_                                       head_cache_ = 0;
+    fdbased::p_eventfd                          eventfd_    = nullptr;
+    alignas(CACHE_LINE_SIZE) std::atomic<t_bool> idle_{false};
+    alignas(CACHE_LINE_SIZE) T                  slots_[N];
+  };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-  inline
-  t_recursive_mutex_lock::operator t_validity() const noexcept {
-    return valid_;
-  }
+  // eventcount: lets a thread sleep on a futex until a lock-free condition
+  // may have changed. waiter: key = prepare_wait(), recheck the condition,
+  // then wait(key) or cancel_wait(). notifier: make the condition true, then
+  // notify_one() or notify_all(), which only enter the kernel when someone
+  // is waiting that no earlier notify is already waking.
+  class t_event_count {
+  public:
+    using t_key = t_futex_value;
 
-///////////////////////////////////////////////////////////////////////////////
+    t_event_count() noexcept;
 
-  inline
-  t_monotonic_lock::operator t_validity() const noexcept {
-    return mutex_ == VALID && cond_ == VALID ? VALID : INVALID;
-  }
+    t_event_count(const t_event_count&)            = delete;
+    t_event_count(t_event_count&&)                 = delete;
+    t_event_count& operator=(const t_event_count&) = delete;
+    t_event_count& operator=(t_event_count&&)      = delete;
+
+    t_key  prepare_wait() noexcept;
+    t_void cancel_wait()  noexcept;
+
+    t_errn wait(       t_key) noexcept;
+    t_void wait(t_err, t_key) noexcept;
+
+    t_errn wait_until(       t_key, t_deadline) noexcept;
+    t_void wait_until(t_err, t_key, t_deadline) noexcept;
+
+    t_void notify_one() noexcept;
+    t_void notify_all() noexcept;
+
+    // notify_one() without its fence, for a condition made true by a
+    // seq_cst read-modify-write that waiters read back with seq_cst loads
+    // after prepare_wait(). the two rmws order each other.
+    t_void notify_one_after_rmw() noexcept;
+
+  private:
+    using t_waiters_ = named::t_uint64;
+
+    constexpr static t_waiters_ WAITER_ = 1;
+    constexpr static t_waiters_ WOKEN_  = t_waiters_{1} << 32;
+
+    t_void leave_() noexcept;
+    t_void wake_(t_waiters_, t_bool all) noexcept;
+
+    // waiters in the low half, how many of them are being woken and have
+    // not left yet in the high half. never more woken than waiters.
+    t_futex                 seq_{0};
+    std::atomic<t_waiters_> waiters_{0};
+  };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-  inline
-  t_cond_var::operator t_validity() const noexcept {
-    return valid_;
-  }
+  // counting semaphore on a futex word. post and try_wait are a single
+  // atomic operation; the kernel is only entered when a waiter must sleep
+  // or a sleeping waiter must be woken. a PROCESS_SHARED semaphore can be
+  // placed in shared memory. post(0) does nothing; a post that would
+  // overflow the count fails with EOVERFLOW and leaves the count unchanged.
+  class t_semaphore {
+  public:
+    using t_value = t_futex_value;
 
-  inline
-  t_errn t_cond_var::wait(t_mutex_lock& lock) noexcept {
-    return wait_(lock.mutex_);
-  }
+     t_semaphore(       t_n)                  noexcept;
+     t_semaphore(t_err, t_n)                  noexcept;
+     t_semaphore(       t_n, t_process_scope) noexcept;
+     t_semaphore(t_err, t_n, t_process_scope) noexcept;
+    ~t_semaphore();
 
-  inline
-  t_void t_cond_var::wait(t_err err, t_mutex_lock& lock) noexcept {
-    wait_(err, lock.mutex_);
-  }
+    t_semaphore(const t_semaphore&)            = delete;
+    t_semaphore(t_semaphore&&)                 = delete;
+    t_semaphore& operator=(const t_semaphore&) = delete;
+    t_semaphore& operator=(t_semaphore&&)      = delete;
 
-  inline
-  t_errn t_cond_var::wait_until(t_mutex_lock& lock, t_time time) noexcept {
-    return wait_until_(lock.mutex_, time);
-  }
+    operator t_validity() const noexcept;
 
-  inline
-  t_void t_cond_var::wait_until(t_err err, t_mutex_lock& lock,
-                                t_time time) noexcept {
-    wait_until_(err, lock.mutex_, time);
-  }
+    t_n get_value() const noexcept;
 
-  inline
-  t_errn t_cond_var::wait(t_recursive_mutex_lock& lock) noexcept {
-    return wait_(lock.mutex_);
-  }
+    t_errn post()      noexcept;
+    t_void post(t_err) noexcept;
 
-  inline
-  t_void t_cond_var::wait(t_err err, t_recursive_mutex_lock& lock) noexcept {
-    wait_(err, lock.mutex_);
-  }
+    t_errn post(       t_n) noexcept;
+    t_void post(t_err, t_n) noexcept;
 
-  inline
-  t_errn t_cond_var::wait_until(t_recursive_mutex_lock& lock,
-                                t_time time) noexcept {
-    return wait_until_(lock.mutex_, time);
-  }
+    t_bool try_wait() noexcept;
 
-  inline
-  t_void t_cond_var::wait_until(t_err err, t_recursive_mutex_lock& lock,
-                                t_time time) noexcept {
-    wait_until_(err, lock.mutex_, time);
-  }
+    t_errn wait()      noexcept;
+    t_void wait(t_err) noexcept;
 
-///////////////////////////////////////////////////////////////////////////////
+    t_errn wait(       t_time) noexcept;
+    t_void wait(t_err, t_time) noexcept;
 
-  inline
-  t_monotonic_cond_var::operator t_validity() const noexcept {
-    return valid_;
-  }
+    t_errn wait(       t_deadline) noexcept;
+    t_void wait(t_err, t_deadline) noexcept;
 
-  inline
-  t_errn t_monotonic_cond_var::wait(t_mutex_lock& lock) noexcept {
-    return wait_(lock.mutex_);
-  }
+  private:
+    enum : t_n_ { SPIN_MAX_ = 64 };
 
-  inline
-  t_void t_monotonic_cond_var::wait(t_err err, t_mutex_lock& lock) noexcept {
-    wait_(err, lock.mutex_);
-  }
+    t_errn wake_(t_n) noexcept;
+    t_errn wait_(       const t_deadline*) noexcept;
+    t_void wait_(t_err, const t_deadline*) noexcept;
 
-  inline
-  t_errn t_monotonic_cond_var::wait_for(t_mutex_lock& lock,
-                                       t_time time) noexcept {
-    return wait_for_(lock.mutex_, time);
-  }
+    t_futex                      cnt_;
+    std::atomic<named::t_uint32> waiters_{0};
+    t_process_scope              scope_ = PROCESS_PRIVATE;
+    t_validity                   valid_ = INVALID;
+  };
 
-  inline
-  t_void t_monotonic_cond_var::wait_for(t_err err, t_mutex_lock& lock,
-                                        t_time time) noexcept {
-    wait_for_(err, lock.mutex_, time);
-  }
+///////////////////////////////////////////////////////////////////////////////
 
-  inline
-  t_errn t_monotonic_cond_var::wait(t_recursive_mutex_lock& lock) noexcept {
-    return wait_(lock.mutex_);
-  }
+  // sense reversing barrier. arrivals count on one cache line while waiters
+  // spin on the phase word on another, which only changes once per phase.
+  // waiters that spin too long sleep on the phase word. the last thread to
+  // arrive gets true from arrive_and_wait().
+  class t_barrier {
+  public:
+     t_barrier(       t_n) noexcept;
+     t_barrier(t_err, t_n) noexcept;
+    ~t_barrier();
 
-  inline
-  t_void t_monotonic_cond_var::wait(t_err err,
-                                    t_recursive_mutex_lock& lock) noexcept {
-    wait_(err, lock.mutex_);
-  }
+    t_barrier(const t_barrier&)            = delete;
+    t_barrier(t_barrier&&)                 = delete;
+    t_barrier& operator=(const t_barrier&) = delete;
+    t_barrier& operator=(t_barrier&&)      = delete;
 
-  inline
-  t_errn t_monotonic_cond_var::wait_for(t_recursive_mutex_lock& lock,
-                                         t_time time) noexcept {
-    return wait_for_(lock.mutex_, time);
-  }
+    operator t_validity() const noexcept;
 
-  inline
-  t_void t_monotonic_cond_var::wait_for(t_err err,
-                                        t_recursive_mutex_lock& lock,
-                                        t_time time) noexcept {
-    return wait_for_(err, lock.mutex_, time);
-  }
+    t_n get_parties() const noexcept;
+
+    t_bool arrive_and_wait()      noexcept;
+    t_bool arrive_and_wait(t_err) noexcept;
+
+  private:
+    enum : t_n_ { SPIN_MAX_ = 1024 };
+
+    t_void wait_(t_futex_value) noexcept;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<t_futex_value> arrived_{0};
+    alignas(CACHE_LINE_SIZE) t_futex                    phase_{0};
+    std::atomic<named::t_uint32>                        sleepers_{0};
+    t_futex_value                                       parties_;
+  };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-  inline
-  t_thread::operator t_validity() const noexcept {
-    return valid_;
-  }
+  // single use countdown latch. threads wait until count_down() has been
+  // called often enough to bring the count to zero, where it stays.
+  class t_latch {
+  public:
+     t_latch(       t_n) noexcept;
+     t_latch(t_err, t_n) noexcept;
+    ~t_latch();
 
-  inline
-  t_bool t_thread::is_joinable() const noexcept {
-    return join_;
-  }
+    t_latch(const t_latch&)            = delete;
+    t_latch(t_latch&&)                 = delete;
+    t_latch& operator=(const t_latch&) = delete;
+    t_latch& operator=(t_latch&&)      = delete;
+
+    operator t_validity() const noexcept;
+
+    t_void count_down()    noexcept;
+    t_void count_down(t_n) noexcept;
+
+    t_bool try_wait() const noexcept;
+
+    t_errn wait()      noexcept;
+    t_void wait(t_err) noexcept;
+
+    t_errn wait(       t_time) noexcept;
+    t_void wait(t_err, t_time) noexcept;
+
+    t_errn wait(       t_deadline) noexcept;
+    t_void wait(t_err, t_deadline) noexcept;
+
+    t_errn arrive_and_wait()      noexcept;
+    t_void arrive_and_wait(t_err) noexcept;
+
+  private:
+    enum : t_n_ { SPIN_MAX_ = 1024 };
+
+    t_errn wait_(const t_deadline*) noexcept;
+
+    alignas(CACHE_LINE_SIZE) t_futex cnt_;
+    std::atomic<named::t_uint32>     waiters_{0};
+    t_validity                       valid_ = INVALID;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // bounded multi producer, multi consumer queue (vyukov). every slot holds a
+  // sequence number that tells producers and consumers whose turn it is, so
+  // the uncontended path is a single CAS on the enqueue or dequeue index.
+  // blocking and timed variants spin first and then park on an eventcount.
+  // the index CAS is seq_cst and parked threads recheck the indices, so
+  // looking for a parked thread is a plain load and not a fence.
+  template<typename T, t_n_ N>
+  class t_mpmc_queue {
+    static_assert(N >= 2 && !(N & (N - 1)), "N must be a power of 2");
+  public:
+    using t_value = T;
+    using r_value = typename named::t_prefix<T>::r_;
+    using R_value = typename named::t_prefix<T>::R_;
+    using x_value = typename named::t_prefix<T>::x_;
+
+    t_mpmc_queue() noexcept;
+
+    t_mpmc_queue(const t_mpmc_queue&)            = delete;
+    t_mpmc_queue(t_mpmc_queue&&)                 = delete;
+    t_mpmc_queue& operator=(const t_mpmc_queue&) = delete;
+    t_mpmc_queue& operator=(t_mpmc_queue&&)      = delete;
+
+    t_n get_capacity() const noexcept;
+
+    // a snapshot, a push or pop in progress counts as done
+    t_bool is_empty() const noexcept;
+
+    t_bool try_push(R_value) noexcept;
+    t_bool try_push(x_value) noexcept;
+    t_bool try_pop (r_value) noexcept;
+
+    t_errn push(       R_value) noexcept;
+    t_void push(t_err, R_value) noexcept;
+    t_errn push(       x_value) noexcept;
+    t_void push(t_err, x_value) noexcept;
+
+    t_errn push(       R_value, t_time) noexcept;
+    t_void push(t_err, R_value, t_time) noexcept;
+
+    t_errn pop(       r_value) noexcept;
+    t_void pop(t_err, r_value) noexcept;
+
+    t_errn pop(       r_value, t_time) noexcept;
+    t_void pop(t_err, r_value, t_time) noexcept;
+
+  private:
+    using t_ix_   = named::t_uint64;
+    using t_diff_ = named::t_int64;
+
+    enum : t_n_ { SPIN_MAX_ = 128 };
+
+    template<typename V> t_bool try_push_(V&&) noexcept;
+
+    // ready: the index says attempt can succeed, maybe once a push or pop
+    // that is in flight is done
+    template<typename F, typename G>
+    t_errn block_(       t_event_count&, F&& attempt, G&& ready,
+                         const t_deadline*) noexcept;
+    template<typename F, typename G>
+    t_void block_(t_err, t_event_count&, F&& attempt, G&& ready,
+                         const t_deadline*) noexcept;
+
+    t_bool can_push_() const noexcept;
+    t_bool can_pop_()  const noexcept;
+
+    struct t_cell_ {
+      std::atomic<t_ix_> seq_;
+      T                  value_;
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<t_ix_> enqueue_{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<t_ix_> dequeue_{0};
+    alignas(CACHE_LINE_SIZE) t_event_count      not_empty_;
+    alignas(CACHE_LINE_SIZE) t_event_count      not_full_;
+    alignas(CACHE_LINE_SIZE) t_cell_            cells_[N];
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // embed in objects that are retired to a t_qsbr domain
+  struct t_qsbr_node {
+    using p_free = t_void (*)(t_qsbr_node*);
+
+    t_qsbr_node*    next_  = nullptr;
+    named::t_uint64 epoch_ = 0;
+    p_free          free_  = nullptr;
+  };
+
+  // quiescent state based reclamation. readers load shared pointers with a
+  // plain acquire load and report quiescent() whenever they hold no
+  // references, e.g. once per loop iteration - no read-modify-write on the
+  // read path. writers publish a new object, retire() the old one and call
+  // reclaim(), which frees what every online reader has passed a quiescent
+  // state for. synchronize() waits for a full grace period instead and must
+  // not be called by an online reader.
+  class t_qsbr {
+  public:
+    constexpr static t_n_ READERS_MAX = 64;
+
+     t_qsbr() noexcept;
+    ~t_qsbr();
+
+    t_qsbr(const t_qsbr&)            = delete;
+    t_qsbr(t_qsbr&&)                 = delete;
+    t_qsbr& operator=(const t_qsbr&) = delete;
+    t_qsbr& operator=(t_qsbr&&)      = delete;
+
+    t_void retire(t_qsbr_node*, t_qsbr_node::p_free) noexcept;
+
+    // T derives from t_qsbr_node and is freed with delete
+    template<typename T>
+    t_void retire(T*) noexcept;
+
+    // returns the number of nodes freed
+    t_n    reclaim()     noexcept;
+    t_void synchronize() noexcept;
+
+  private:
+    friend class t_qsbr_reader;
+    using t_epoch_ = named::t_uint64;
+
+    struct alignas(CACHE_LINE_SIZE) t_slot_ {
+      std::atomic<t_epoch_> epoch{0}; // 0 is offline
+      std::atomic<t_bool>   used{false};
+    };
+
+    t_slot_* claim_() noexcept;
+    t_epoch_ get_min_epoch_() const noexcept;
+    t_void   push_(t_qsbr_node* first, t_qsbr_node* last) noexcept;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<t_epoch_>     epoch_{1};
+    alignas(CACHE_LINE_SIZE) std::atomic<t_qsbr_node*> retired_{nullptr};
+    t_slot_ slots_[READERS_MAX];
+  };
+
+  // registration of one reader thread in a t_qsbr domain. it starts online;
+  // go offline() before blocking for long so writers are not held up. a
+  // reader is invalid when all READERS_MAX slots are taken, it then ignores
+  // quiescent(), offline() and online() and protects nothing.
+  class t_qsbr_reader {
+  public:
+     t_qsbr_reader(       t_qsbr&) noexcept;
+     t_qsbr_reader(t_err, t_qsbr&) noexcept;
+    ~t_qsbr_reader();
+
+    t_qsbr_reader(const t_qsbr_reader&)            = delete;
+    t_qsbr_reader(t_qsbr_reader&&)                 = delete;
+    t_qsbr_reader& operator=(const t_qsbr_reader&) = delete;
+    t_qsbr_reader& operator=(t_qsbr_reader&&)      = delete;
+
+    operator t_validity() const noexcept;
+
+    t_void quiescent() noexcept;
+    t_void offline()   noexcept;
+    t_void online()    noexcept;
+
+  private:
+    t_qsbr&          qsbr_;
+    t_qsbr::t_slot_* slot_;
+  };
+
+  // pointer to a published object. readers get(), writers publish() a new
+  // object and retire the previous one.
+  template<typename T>
+  class t_qsbr_ptr {
+  public:
+    t_qsbr_ptr(T* = nullptr) noexcept;
+
+    t_qsbr_ptr(const t_qsbr_ptr&)            = delete;
+    t_qsbr_ptr(t_qsbr_ptr&&)                 = delete;
+    t_qsbr_ptr& operator=(const t_qsbr_ptr&) = delete;
+    t_qsbr_ptr& operator=(t_qsbr_ptr&&)      = delete;
+
+    T* get() const noexcept;
+    T* publish(T*) noexcept;
+
+  private:
+    std::atomic<T*> ptr_;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // sequence lock for a small trivially copyable value with a single writer.
+  // readers copy the value and retry when the sequence was odd or changed
+  // meanwhile; they never write shared memory. the value is kept in relaxed
+  // atomic words, so a torn copy is discarded, never undefined.
+  template<typename T>
+  class t_seqlock {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "T must be trivially copyable");
+  public:
+    using t_value = T;
+    using r_value = typename named::t_prefix<T>::r_;
+    using R_value = typename named::t_prefix<T>::R_;
+
+    t_seqlock()        noexcept;
+    t_seqlock(R_value) noexcept;
+
+    t_seqlock(const t_seqlock&)            = delete;
+    t_seqlock(t_seqlock&&)                 = delete;
+    t_seqlock& operator=(const t_seqlock&) = delete;
+    t_seqlock& operator=(t_seqlock&&)      = delete;
+
+    // writer, one at a time
+    t_void store(R_value) noexcept;
+
+    t_value load    ()        const noexcept;
+    t_bool  try_load(r_value) const noexcept;
+
+  private:
+    using t_seq_  = named::t_uint64;
+    using t_word_ = named::t_uint64;
+
+    enum : t_n_ { WORDS_ = (sizeof(T) + sizeof(t_word_) - 1) / sizeof(t_word_) };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<t_seq_> seq_{0};
+    std::atomic<t_word_>                         data_[WORDS_];
+  };
+
+  // N seqlocks written round robin. the writer fills the slot after the
+  // current one and then publishes it, so a reader only retries when the
+  // writer has lapped it N times during a single copy.
+  template<typename T, t_n_ N = 4>
+  class t_multi_seqlock {
+    static_assert(N >= 2, "N must be at least 2");
+  public:
+    using t_value = T;
+    using r_value = typename named::t_prefix<T>::r_;
+    using R_value = typename named::t_prefix<T>::R_;
+
+    t_multi_seqlock()        noexcept;
+    t_multi_seqlock(R_value) noexcept;
+
+    t_multi_seqlock(const t_multi_seqlock&)            = delete;
+    t_multi_seqlock(t_multi_seqlock&&)                 = delete;
+    t_multi_seqlock& operator=(const t_multi_seqlock&) = delete;
+    t_multi_seqlock& operator=(t_multi_seqlock&&)      = delete;
+
+    // writer, one at a time
+    t_void store(R_value) noexcept;
+
+    t_value load    ()        const noexcept;
+    t_bool  try_load(r_value) const noexcept;
+
+  private:
+    alignas(CACHE_LINE_SIZE) std::atomic<named::t_uint64> current_{0};
+    t_seqlock<T>                                          slots_[N];
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(__x86_64__)
+  // stackful fibers on one os thread. spawn() places the fiber and its
+  // callable on a pooled, guard-paged stack; run() switches between ready
+  // fibers and sleeps in epoll when all of them wait for fds. inside a
+  // fiber, wait_readable()/wait_writable() and the read() helpers suspend
+  // the fiber instead of blocking the thread. fds used this way should be
+  // non blocking, except eventfd and timerfd with a single reader. only one
+  // fiber at a time may wait on an fd, a second one gets EBUSY. destroying
+  // the scheduler destroys the callables of fibers that did not finish,
+  // but not what a suspended fiber holds on its stack.
+  class t_fiber_scheduler {
+  public:
+    using t_event_mask = fdbased::t_epoll::t_event_mask;
+    using t_fd         = named::t_fd;
+
+     t_fiber_scheduler(       t_stack_size) noexcept;
+     t_fiber_scheduler(t_err, t_stack_size) noexcept;
+    ~t_fiber_scheduler();
+
+    t_fiber_scheduler(const t_fiber_scheduler&)            = delete;
+    t_fiber_scheduler(t_fiber_scheduler&&)                 = delete;
+    t_fiber_scheduler& operator=(const t_fiber_scheduler&) = delete;
+    t_fiber_scheduler& operator=(t_fiber_scheduler&&)      = delete;
+
+    operator t_validity() const noexcept;
+
+    t_n get_fibers() const noexcept;
+
+    template<typename F, typename = t_thread::t_callable_<F>>
+    t_errn spawn(       F&&) noexcept;
+    template<typename F, typename = t_thread::t_callable_<F>>
+    t_void spawn(t_err, F&&) noexcept;
+
+    // runs until every fiber has finished
+    t_errn run()      noexcept;
+    t_void run(t_err) noexcept;
+
+    // the scheduler running on this thread, nullptr outside run()
+    static t_fiber_scheduler* get_current() noexcept;
+
+    // only from inside a fiber
+    t_void yield() noexcept;
+
+    t_errn wait_readable(t_fd) noexcept;
+    t_errn wait_writable(t_fd) noexcept;
+
+    t_errn read(fdbased::r_eventfd, fdbased::t_eventfd::r_value) noexcept;
+    t_errn read(fdbased::r_timerfd, fdbased::t_timerfd::r_data)  noexcept;
+
+  private:
+    struct t_fiber_ {
+      p_void             sp     = nullptr;
+      t_fiber_*          next   = nullptr;
+      t_fiber_scheduler* sched  = nullptr;
+      p_void             stack  = nullptr;
+      p_void             store  = nullptr;
+      t_void           (*run)    (p_void) = nullptr;
+      t_void           (*destroy)(p_void) = nullptr;
+      t_fiber_*          prev_fiber = nullptr;
+      t_fiber_*          next_fiber = nullptr;
+      t_event_mask       events = 0;
+      t_bool             done   = false;
+    };
+    using p_fiber_ = t_fiber_*;
+
+    p_fiber_ create_(t_n_ size, t_n_ align) noexcept;
+    t_void   start_(p_fiber_) noexcept;
+    t_void   ready_(p_fiber_) noexcept;
+    t_void   suspend_()       noexcept;
+    t_errn   wait_(t_fd, t_event_mask) noexcept;
+    p_void   alloc_stack_()       noexcept;
+    t_void   free_stack_(p_void)  noexcept;
+
+    static t_void main_(p_void) noexcept;
+
+    fdbased::t_epoll epoll_;
+    t_n_             stack_size_ = 0;
+    t_n_             map_size_   = 0;
+    p_void           free_       = nullptr;
+    p_fiber_         head_       = nullptr;
+    p_fiber_         tail_       = nullptr;
+    p_fiber_         current_    = nullptr;
+    p_fiber_         fibers_     = nullptr; // not finished yet
+    p_void           sp_         = nullptr;
+    t_n_             live_       = 0;
+    t_validity       valid_      = INVALID;
+  };
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename L>
+  inline t_locked_scope<L>::operator t_validity() const noexcept {
+    return lock_ ? VALID : INVALID;
+  }
+
+  template<typename L>
+  inline
+  t_locked_scope<L>::t_locked_scope(p_lock lock) noexcept
+    : lock_(lock) {
+  }
+
+  template<typename L>
+  inline
+  typename t_locked_scope<L>::p_lock
+    t_locked_scope<L>::swap_(p_lock lock) noexcept {
+    p_lock tmp = lock_;
+    lock_ = lock;
+    return tmp;
+  }
+
+  template<typename L>
+  inline
+  t_locked_scope<L>::t_locked_scope(t_locked_scope&& scope) noexcept
+    : lock_(scope.swap_(nullptr)) {
+    if (lock_)
+      lock_->enter_scope_(this);
+  }
+
+  template<typename L>
+  inline
+  t_locked_scope<L>::~t_locked_scope() {
+    if (lock_)
+      lock_->leave_scope_(this);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_mutex_lock::operator t_validity() const noexcept {
+    return valid_;
+  }
+
+  inline
+  t_bool t_mutex_lock::is_owner_dead() const noexcept {
+    return dead_;
+  }
+
+  inline
+  t_errn t_mutex_lock::mark_(t_errn errn) noexcept {
+    if (get(errn) == EOWNERDEAD)
+      dead_ = true;
+    return errn;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_recursive_mutex_lock::operator t_validity() const noexcept {
+    return valid_;
+  }
+
+  // not robust
+  inline
+  t_errn t_recursive_mutex_lock::mark_(t_errn errn) noexcept {
+    return errn;
+  }
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_monotonic_lock::operator t_validity() const noexcept {
+    return mutex_ == VALID && cond_ == VALID ? VALID : INVALID;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_cond_var::operator t_validity() const noexcept {
+    return valid_;
+  }
+
+  inline
+  t_errn t_cond_var::wait(t_mutex_lock& lock) noexcept {
+    return lock.mark_(wait_(lock.mutex_));
+  }
+
+  inline
+  t_void t_cond_var::wait(t_err err, t_mutex_lock& lock) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID)
+        lock.mark_(err, wait_(lock.mutex_));
+      else
+        err = err::E_INVALID_INST;
+    }
+  }
+
+  inline
+  t_errn t_cond_var::wait_until(t_mutex_lock& lock, t_time time) noexcept {
+    return lock.mark_(wait_until_(lock.mutex_, time));
+  }
+
+  inline
+  t_void t_cond_var::wait_until(t_err err, t_mutex_lock& lock,
+                                t_time time) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID)
+        lock.mark_(err, wait_until_(lock.mutex_, time));
+      else
+        err = err::E_INVALID_INST;
+    }
+  }
+
+  inline
+  t_errn t_cond_var::wait(t_recursive_mutex_lock& lock) noexcept {
+    return wait_(lock.mutex_);
+  }
+
+  inline
+  t_void t_cond_var::wait(t_err err, t_recursive_mutex_lock& lock) noexcept {
+    wait_(err, lock.mutex_);
+  }
+
+  inline
+  t_errn t_cond_var::wait_until(t_recursive_mutex_lock& lock,
+                                t_time time) noexcept {
+    return wait_until_(lock.mutex_, time);
+  }
+
+  inline
+  t_void t_cond_var::wait_until(t_err err, t_recursive_mutex_lock& lock,
+                                t_time time) noexcept {
+    wait_until_(err, lock.mutex_, time);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_monotonic_cond_var::operator t_validity() const noexcept {
+    return valid_;
+  }
+
+  inline
+  t_errn t_monotonic_cond_var::wait(t_mutex_lock& lock) noexcept {
+    return lock.mark_(wait_(lock.mutex_));
+  }
+
+  inline
+  t_void t_monotonic_cond_var::wait(t_err err, t_mutex_lock& lock) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID)
+        lock.mark_(err, wait_(lock.mutex_));
+      else
+        err = err::E_INVALID_INST;
+    }
+  }
+
+  inline
+  t_errn t_monotonic_cond_var::wait_for(t_mutex_lock& lock,
+                                       t_time time) noexcept {
+    return lock.mark_(wait_for_(lock.mutex_, time));
+  }
+
+  inline
+  t_void t_monotonic_cond_var::wait_for(t_err err, t_mutex_lock& lock,
+                                        t_time time) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID)
+        lock.mark_(err, wait_for_(lock.mutex_, time));
+      else
+        err = err::E_INVALID_INST;
+    }
+  }
+
+  inline
+  t_errn t_monotonic_cond_var::wait_until(t_mutex_lock& lock,
+                                         t_deadline deadline) noexcept {
+    return lock.mark_(wait_until_(lock.mutex_, deadline));
+  }
+
+  inline
+  t_void t_monotonic_cond_var::wait_until(t_err err, t_mutex_lock& lock,
+                                          t_deadline deadline) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID)
+        lock.mark_(err, wait_until_(lock.mutex_, deadline));
+      else
+        err = err::E_INVALID_INST;
+    }
+  }
+
+  inline
+  t_errn t_monotonic_cond_var::wait(t_recursive_mutex_lock& lock) noexcept {
+    return wait_(lock.mutex_);
+  }
+
+  inline
+  t_void t_monotonic_cond_var::wait(t_err err,
+                                    t_recursive_mutex_lock& lock) noexcept {
+    wait_(err, lock.mutex_);
+  }
+
+  inline
+  t_errn t_monotonic_cond_var::wait_for(t_recursive_mutex_lock& lock,
+                                         t_time time) noexcept {
+    return wait_for_(lock.mutex_, time);
+  }
+
+  inline
+  t_void t_monotonic_cond_var::wait_for(t_err err,
+                                        t_recursive_mutex_lock& lock,
+                                        t_time time) noexcept {
+    return wait_for_(err, lock.mutex_, time);
+  }
+
+  inline
+  t_errn t_monotonic_cond_var::wait_until(t_recursive_mutex_lock& lock,
+                                          t_deadline deadline) noexcept {
+    return wait_until_(lock.mutex_, deadline);
+  }
+
+  inline
+  t_void t_monotonic_cond_var::wait_until(t_err err,
+                                          t_recursive_mutex_lock& lock,
+                                          t_deadline deadline) noexcept {
+    wait_until_(err, lock.mutex_, deadline);
+  }
+
+  inline std::atomic<t_bool> fences_registered_{false};
+
+  inline
+  t_bool has_heavy_fence() noexcept {
+    return fences_registered_.load(std::memory_order_relaxed);
+  }
+
+  inline
+  t_void light_fence() noexcept {
+    if (has_heavy_fence())
+      std::atomic_signal_fence(std::memory_order_seq_cst);
+    else
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename P>
+  inline
+  t_errn t_spin_park_::spin(r_pthread_mutex mutex, P& pred) noexcept {
+    return spin_(mutex, pred, nullptr);
+  }
+
+  template<typename P>
+  inline
+  t_errn t_spin_park_::spin(r_pthread_mutex mutex, P& pred,
+                            const t_deadline& deadline) noexcept {
+    return spin_(mutex, pred, &deadline);
+  }
+
+  template<typename P>
+  inline
+  t_errn t_spin_park_::spin_(r_pthread_mutex mutex, P& pred,
+                             const t_deadline* deadline) noexcept {
+    t_errn errn{0};
+    if (get_spin_max_(SPIN_MAX)) {
+      errn = call_pthread_mutex_unlock(mutex);
+      if (errn == VALID) {
+        spins_.fetch_add(1, std::memory_order_relaxed);
+        t_n_   budget  = budget_.load(std::memory_order_relaxed);
+        t_n_   spun    = 0;
+        t_bool expired = false;
+        for (; spun < budget && !pred(); ++spun) {
+          if (deadline && !(spun % CLOCK_SPINS) && deadline->is_expired()) {
+            expired = true;
+            break;
+          }
+          relax_cpu();
+        }
+        if (!expired)
+          adapt_(budget, spun, spun < budget);
+        errn = call_pthread_mutex_lock(mutex);
+      }
+    }
+    return errn;
+  }
+
+  inline
+  t_void t_spin_park_::parked() noexcept {
+    parks_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_spin_stats t_cond_var::get_spin_stats() const noexcept {
+    return spin_.get_stats();
+  }
+
+  template<typename L, typename P>
+  inline
+  t_errn t_cond_var::spin_wait(L& lock, P pred) noexcept {
+    t_errn errn{-1};
+    if (valid_ == VALID) {
+      errn = t_errn{0};
+      if (!pred()) {
+        errn = lock.mark_(spin_.spin(lock.mutex_, pred));
+        if (errn == VALID && !pred()) {
+          spin_.parked();
+          do
+            errn = lock.mark_(wait_(lock.mutex_));
+          while (errn == VALID && !pred());
+        }
+      }
+    }
+    return errn;
+  }
+
+  template<typename L, typename P>
+  inline
+  t_void t_cond_var::spin_wait(t_err err, L& lock, P pred) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID) {
+        if (!pred()) {
+          auto errn = lock.mark_(err, spin_.spin(lock.mutex_, pred));
+          if (errn == VALID && !pred()) {
+            spin_.parked();
+            do
+              errn = lock.mark_(err, wait_(lock.mutex_));
+            while (errn == VALID && !pred());
+          }
+        }
+      } else
+        err = err::E_INVALID_INST;
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_spin_stats t_monotonic_cond_var::get_spin_stats() const noexcept {
+    return spin_.get_stats();
+  }
+
+  template<typename L, typename P>
+  inline
+  t_errn t_monotonic_cond_var::spin_wait(L& lock, P pred) noexcept {
+    t_errn errn{-1};
+    if (valid_ == VALID) {
+      errn = t_errn{0};
+      if (!pred()) {
+        errn = lock.mark_(spin_.spin(lock.mutex_, pred));
+        if (errn == VALID && !pred()) {
+          spin_.parked();
+          do
+            errn = lock.mark_(wait_(lock.mutex_));
+          while (errn == VALID && !pred());
+        }
+      }
+    }
+    return errn;
+  }
+
+  template<typename L, typename P>
+  inline
+  t_void t_monotonic_cond_var::spin_wait(t_err err, L& lock, P pred) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == VALID) {
+        if (!pred()) {
+          auto errn = lock.mark_(err, spin_.spin(lock.mutex_, pred));
+          if (errn == VALID && !pred()) {
+            spin_.parked();
+            do
+              errn = lock.mark_(err, wait_(lock.mutex_));
+            while (errn == VALID && !pred());
+          }
+        }
+      } else
+        err = err::E_INVALID_INST;
+    }
+  }
+
+  template<typename L, typename P>
+  inline
+  t_bool t_monotonic_cond_var::spin_wait_until(L& lock, t_deadline deadline,
+                                               P pred) noexcept {
+    if (valid_ == INVALID)
+      return false;
+    if (pred())
+      return true;
+    if (lock.mark_(spin_.spin(lock.mutex_, pred, deadline)) == INVALID)
+      return false;
+    if (pred())
+      return true;
+    spin_.parked();
+    return wait_until(lock, deadline, pred);
+  }
+
+  template<typename L, typename P>
+  inline
+  t_bool t_monotonic_cond_var::spin_wait_until(t_err err, L& lock,
+                                               t_deadline deadline,
+                                               P pred) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == INVALID) {
+        err = err::E_INVALID_INST;
+        return false;
+      }
+      if (pred())
+        return true;
+      if (lock.mark_(err, spin_.spin(lock.mutex_, pred, deadline)) == INVALID)
+        return false;
+      if (pred())
+        return true;
+      spin_.parked();
+      return wait_until(err, lock, deadline, pred);
+    }
+    return false;
+  }
+
+  template<typename L, typename P>
+  inline
+  t_bool t_monotonic_cond_var::wait_until(L& lock, t_deadline deadline,
+                                          P pred) noexcept {
+    while (!pred()) {
+      auto errn = lock.mark_(wait_until_(lock.mutex_, deadline));
+      if (errn == INVALID)
+        return get(errn) != EOWNERDEAD && pred();
+    }
+    return true;
+  }
+
+  template<typename L, typename P>
+  inline
+  t_bool t_monotonic_cond_var::wait_until(t_err err, L& lock,
+                                          t_deadline deadline,
+                                          P pred) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == INVALID) {
+        err = err::E_INVALID_INST;
+        return false;
+      }
+      while (!pred()) {
+        auto errn = lock.mark_(wait_until_(lock.mutex_, deadline));
+        if (errn == INVALID) {
+          if (get(errn) != EOWNERDEAD && pred())
+            return true;
+          lock.mark_(err, errn);
+          return false;
+        }
+      }
+      return true;
+    }
+    return false;
+  }
+
+  template<typename L, typename P>
+  inline
+  t_bool t_monotonic_cond_var::wait_for(L& lock, t_time time,
+                                        P pred) noexcept {
+    return wait_until(lock, t_deadline{time}, pred);
+  }
+
+  template<typename L, typename P>
+  inline
+  t_bool t_monotonic_cond_var::wait_for(t_err err, L& lock, t_time time,
+                                        P pred) noexcept {
+    ERR_GUARD(err) {
+      t_deadline deadline{err, time};
+      return wait_until(err, lock, deadline, pred);
+    }
+    return false;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_arena::operator t_validity() const noexcept {
+    return head_ ? VALID : INVALID;
+  }
+
+  inline
+  p_void t_arena::allocate(t_n size, t_n align) noexcept {
+    if (!get(align) || (get(align) & (get(align) - 1)))
+      return nullptr;
+    auto p = reinterpret_cast<named::t_uint8*>(
+      (reinterpret_cast<::uintptr_t>(ptr_) + get(align) - 1) &
+        ~(::uintptr_t)(get(align) - 1));
+    if (ptr_ && p + get(size) <= end_) {
+      used_ += (p + get(size)) - ptr_;
+      ptr_   = p + get(size);
+      return p;
+    }
+    return grow_(get(size), get(align));
+  }
+
+  inline
+  p_void t_arena::allocate(t_n size) noexcept {
+    return allocate(size, t_n{alignof(::max_align_t)});
+  }
+
+  template<typename T, typename... Args>
+  inline
+  T* t_arena::make(Args&&... args) noexcept {
+    p_void ptr = allocate(t_n{sizeof(T)}, t_n{alignof(T)});
+    return ptr ? new (ptr) T(std::forward<Args>(args)...) : nullptr;
+  }
+
+  inline
+  t_n t_arena::get_used() const noexcept {
+    return t_n{used_};
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_arena_slab::t_arena_slab(r_arena arena) noexcept : arena_(arena) {
+  }
+
+  inline
+  t_n_ t_arena_slab::class_of_(t_n_ size) noexcept {
+    t_n_ ix = 0;
+    for (t_n_ block = MIN_BLOCK; block < size; block <<= 1)
+      ++ix;
+    return ix;
+  }
+
+  inline
+  p_void t_arena_slab::allocate(t_n size) noexcept {
+    if (get(size) > MAX_BLOCK)
+      return arena_.allocate(size);
+    t_n_ ix = class_of_(get(size));
+    if (free_[ix]) {
+      t_free_* block = free_[ix];
+      free_[ix] = block->next_;
+      return block;
+    }
+    return arena_.allocate(t_n{MIN_BLOCK << ix});
+  }
+
+  inline
+  t_void t_arena_slab::deallocate(p_void ptr, t_n size) noexcept {
+    if (ptr && get(size) <= MAX_BLOCK) {
+      t_n_ ix = class_of_(get(size));
+      free_[ix] = new (ptr) t_free_{free_[ix]};
+    }
+  }
+
+  inline
+  t_void t_arena_slab::reset() noexcept {
+    for (auto& list : free_)
+      list = nullptr;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_thread::operator t_validity() const noexcept {
+    return valid_;
+  }
+
+  inline
+  t_bool t_thread::is_joinable() const noexcept {
+    return join_;
+  }
+
+  template<typename F>
+  inline
+  p_void t_thread::start_(p_void ptr) noexcept {
+    using t_func = typename std::decay<F>::type;
+    using t_ref  = typename std::remove_reference<F>::type;
+    t_thread_registry::t_scope scope;
+    auto& handoff = *static_cast<t_handoff_*>(ptr);
+    auto  source  = static_cast<const t_ref*>(handoff.callable);
+    t_func func(std::forward<F>(*const_cast<t_ref*>(source)));
+    notify_moved_(handoff);
+    func();
+    return nullptr;
+  }
+
+  template<typename F, typename>
+  inline
+  t_thread::t_thread(F&& func) noexcept {
+    create(std::forward<F>(func));
+  }
+
+  template<typename F, typename>
+  inline
+  t_thread::t_thread(t_err err, F&& func) noexcept {
+    create(err, std::forward<F>(func));
+  }
+
+  template<typename F, typename>
+  inline
+  t_thread::t_thread(F&& func, R_pthread_attr attr) noexcept {
+    create(std::forward<F>(func), attr);
+  }
+
+  template<typename F, typename>
+  inline
+  t_thread::t_thread(t_err err, F&& func, R_pthread_attr attr) noexcept {
+    create(err, std::forward<F>(func), attr);
+  }
+
+  template<typename F, typename>
+  inline
+  t_thread::t_thread(F&& func, t_stack_size size) noexcept {
+    create(std::forward<F>(func), size);
+  }
+
+  template<typename F, typename>
+  inline
+  t_thread::t_thread(t_err err, F&& func, t_stack_size size) noexcept {
+    create(err, std::forward<F>(func), size);
+  }
+
+  template<typename F, typename>
+  inline
+  t_thread::t_thread(F&& func, R_pthread_attr attr,
+                     t_stack_size size) noexcept {
+    create(std::forward<F>(func), attr, size);
+  }
+
+  template<typename F, typename>
+  inline
+  t_thread::t_thread(t_err err, F&& func, R_pthread_attr attr,
+                     t_stack_size size) noexcept {
+    create(err, std::forward<F>(func), attr, size);
+  }
+
+  template<typename F, typename>
+  inline
+  t_errn t_thread::create(F&& func) noexcept {
+    static_assert(sizeof(typename std::decay<F>::type) <= CALLABLE_MAX,
+                  "t_thread: callable state too large");
+    t_errn errn{-1};
+    if (valid_ == INVALID) {
+      t_source_<F> source(std::forward<F>(func));
+      t_handoff_ handoff{&source};
+      errn = call_pthread_create(thread_, start_<t_source_<F>>, &handoff);
+      if (errn == VALID) {
+        wait_moved_(handoff);
+        join_  = true;
+        valid_ = VALID;
+      }
+    }
+    return errn;
+  }
+
+  template<typename F, typename>
+  inline
+  t_void t_thread::create(t_err err, F&& func) noexcept {
+    static_assert(sizeof(typename std::decay<F>::type) <= CALLABLE_MAX,
+                  "t_thread: callable state too large");
+    ERR_GUARD(err) {
+      if (valid_ == INVALID) {
+        t_source_<F> source(std::forward<F>(func));
+        t_handoff_ handoff{&source};
+        call_pthread_create(err, thread_, start_<t_source_<F>>, &handoff);
+        if (!err) {
+          wait_moved_(handoff);
+          join_  = true;
+          valid_ = VALID;
+        }
+      } else
+        err = err::E_VALID_INST;
+    }
+  }
+
+  template<typename F, typename>
+  inline
+  t_errn t_thread::create(F&& func, R_pthread_attr attr) noexcept {
+    static_assert(sizeof(typename std::decay<F>::type) <= CALLABLE_MAX,
+                  "t_thread: callable state too large");
+    t_errn errn{-1};
+    if (valid_ == INVALID) {
+      t_source_<F> source(std::forward<F>(func));
+      t_handoff_ handoff{&source};
+      errn = call_pthread_create(thread_, attr, start_<t_source_<F>>,
+                                 &handoff);
+      if (errn == VALID) {
+        wait_moved_(handoff);
+        join_  = !call_pthread_is_detach(attr);
+        valid_ = VALID;
+      }
+    }
+    return errn;
+  }
+
+  template<typename F, typename>
+  inline
+  t_void t_thread::create(t_err err, F&& func, R_pthread_attr attr) noexcept {
+    static_assert(sizeof(typename std::decay<F>::type) <= CALLABLE_MAX,
+                  "t_thread: callable state too large");
+    ERR_GUARD(err) {
+      if (valid_ == INVALID) {
+        t_source_<F> source(std::forward<F>(func));
+        t_handoff_ handoff{&source};
+        call_pthread_create(err, thread_, attr, start_<t_source_<F>>,
+                            &handoff);
+        if (!err) {
+          wait_moved_(handoff);
+          join_  = !call_pthread_is_detach(attr);
+          valid_ = VALID;
+        }
+      } else
+        err = err::E_VALID_INST;
+    }
+  }
+
+  template<typename F, typename>
+  inline
+  t_errn t_thread::create(F&& func, t_stack_size size) noexcept {
+    t_errn errn{-1};
+    if (valid_ == INVALID) {
+      ::pthread_attr_t attr;
+      errn = map_stack_(attr, nullptr, size);
+      if (errn == VALID) {
+        errn = create(std::forward<F>(func), attr);
+        call_pthread_destroy(attr);
+        if (errn == INVALID)
+          unmap_stack_();
+      }
+    }
+    return errn;
+  }
+
+  template<typename F, typename>
+  inline
+  t_void t_thread::create(t_err err, F&& func, t_stack_size size) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == INVALID) {
+        ::pthread_attr_t attr;
+        if (map_stack_(attr, nullptr, size) == VALID) {
+          create(err, std::forward<F>(func), attr);
+          call_pthread_destroy(attr);
+          if (err)
+            unmap_stack_();
+        } else
+          err = err::E_XXX;
+      } else
+        err = err::E_VALID_INST;
+    }
+  }
+
+  template<typename F, typename>
+  inline
+  t_errn t_thread::create(F&& func, R_pthread_attr from,
+                          t_stack_size size) noexcept {
+    t_errn errn{-1};
+    if (valid_ == INVALID && !call_pthread_is_detach(from)) {
+      ::pthread_attr_t attr;
+      errn = map_stack_(attr, &from, size);
+      if (errn == VALID) {
+        errn = create(std::forward<F>(func), attr);
+        call_pthread_destroy(attr);
+        if (errn == INVALID)
+          unmap_stack_();
+      }
+    }
+    return errn;
+  }
+
+  template<typename F, typename>
+  inline
+  t_void t_thread::create(t_err err, F&& func, R_pthread_attr from,
+                          t_stack_size size) noexcept {
+    ERR_GUARD(err) {
+      if (valid_ == INVALID) {
+        ::pthread_attr_t attr;
+        if (!call_pthread_is_detach(from) &&
+            map_stack_(attr, &from, size) == VALID) {
+          create(err, std::forward<F>(func), attr);
+          call_pthread_destroy(attr);
+          if (err)
+            unmap_stack_();
+        } else
+          err = err::E_XXX;
+      } else
+        err = err::E_VALID_INST;
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, t_n_ N>
+  inline
+  t_spsc_ring<T, N>::t_spsc_ring() noexcept {
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_spsc_ring<T, N>::t_spsc_ring(fdbased::r_eventfd eventfd) noexcept
+    : eventfd_{&eventfd} {
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_n t_spsc_ring<T, N>::get_capacity() const noexcept {
+    return t_n{N};
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_spsc_ring<T, N>::is_empty() const noexcept {
+    return tail_.load(std::memory_order_acquire) ==
+           head_.load(std::memory_order_acquire);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_spsc_ring<T, N>::reserve_(t_ix_ tail, t_n_ n) noexcept {
+    if (tail - head_cache_ + n <= N)
+      return true;
+    head_cache_ = head_.load(std::memory_order_acquire);
+    return tail - head_cache_ + n <= N;
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_void t_spsc_ring<T, N>::publish_(t_ix_ tail) noexcept {
+    tail_.store(tail, std::memory_order_release);
+    if (eventfd_) {
+      // pairs with the fence in park()
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (idle_.load(std::memory_order_relaxed) &&
+          idle_.exchange(false, std::memory_order_relaxed)) {
+        fdbased::t_eventfd::t_value one = 1;
+        eventfd_->write(one);
+      }
+    }
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_spsc_ring<T, N>::push(R_value value) noexcept {
+    t_ix_ tail = tail_.load(std::memory_order_relaxed);
+    if (reserve_(tail, 1)) {
+      slots_[tail & (N - 1)] = value;
+      publish_(tail + 1);
+      return true;
+    }
+    return false;
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_spsc_ring<T, N>::push(x_value value) noexcept {
+    t_ix_ tail = tail_.load(std::memory_order_relaxed);
+    if (reserve_(tail, 1)) {
+      slots_[tail & (N - 1)] = std::move(value);
+      publish_(tail + 1);
+      return true;
+    }
+    return false;
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_n t_spsc_ring<T, N>::push(P_value values, t_n max) noexcept {
+    t_ix_ tail = tail_.load(std::memory_order_relaxed);
+    t_n_  n    = get(max);
+    if (!reserve_(tail, n))
+      n = N - (tail - head_cache_);
+    if (n) {
+      for (t_n_ i = 0; i < n; ++i)
+        slots_[(tail + i) & (N - 1)] = values[i];
+      publish_(tail + n);
+    }
+    return t_n{n};
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_spsc_ring<T, N>::pop(r_value value) noexcept {
+    t_ix_ head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_)
+        return false;
+    }
+    value = std::move(slots_[head & (N - 1)]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_n t_spsc_ring<T, N>::pop(p_value values, t_n max) noexcept {
+    t_ix_ head = head_.load(std::memory_order_relaxed);
+    t_n_  n    = get(max);
+    if (tail_cache_ - head < n)
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+    if (tail_cache_ - head < n)
+      n = tail_cache_ - head;
+    if (n) {
+      for (t_n_ i = 0; i < n; ++i)
+        values[i] = std::move(slots_[(head + i) & (N - 1)]);
+      head_.store(head + n, std::memory_order_release);
+    }
+    return t_n{n};
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_spsc_ring<T, N>::park() noexcept {
+    idle_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (tail_.load(std::memory_order_relaxed) !=
+        head_.load(std::memory_order_relaxed)) {
+      idle_.store(false, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_void t_spsc_ring<T, N>::unpark() noexcept {
+    idle_.store(false, std::memory_order_relaxed);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_event_count::t_event_count() noexcept {
+  }
+
+  inline
+  t_event_count::t_key t_event_count::prepare_wait() noexcept {
+    t_key key = seq_.load(std::memory_order_acquire);
+    waiters_.fetch_add(WAITER_, std::memory_order_seq_cst);
+    return key;
+  }
+
+  inline
+  t_void t_event_count::cancel_wait() noexcept {
+    leave_();
+  }
+
+  // a waiter that is already being woken needs no second wake, so a
+  // burst of notifies before it runs enters the kernel once
+  inline
+  t_void t_event_count::notify_one() noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto waiters = waiters_.load(std::memory_order_relaxed);
+    if ((waiters & (WOKEN_ - 1)) > (waiters >> 32))
+      wake_(waiters, false);
+  }
+
+  inline
+  t_void t_event_count::notify_all() noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto waiters = waiters_.load(std::memory_order_relaxed);
+    if ((waiters & (WOKEN_ - 1)) > (waiters >> 32))
+      wake_(waiters, true);
+  }
+
+  inline
+  t_void t_event_count::notify_one_after_rmw() noexcept {
+    auto waiters = waiters_.load(std::memory_order_seq_cst);
+    if ((waiters & (WOKEN_ - 1)) > (waiters >> 32))
+      wake_(waiters, false);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_semaphore::operator t_validity() const noexcept {
+    return valid_;
+  }
+
+  inline
+  t_n t_semaphore::get_value() const noexcept {
+    return t_n{cnt_.load(std::memory_order_relaxed)};
+  }
+
+  inline
+  t_bool t_semaphore::try_wait() noexcept {
+    t_value cnt = cnt_.load(std::memory_order_relaxed);
+    while (cnt)
+      if (cnt_.compare_exchange_weak(cnt, cnt - 1,
+                                     std::memory_order_acquire,
+                                     std::memory_order_relaxed))
+        return true;
+    return false;
+  }
+
+  inline
+  t_errn t_semaphore::post(t_n n) noexcept {
+    if (valid_ == VALID) {
+      if (!get(n))
+        return t_errn{0};
+      constexpr t_value MAX = std::numeric_limits<t_value>::max();
+      if (get(n) > MAX)
+        return t_errn{EOVERFLOW};
+      t_value add = static_cast<t_value>(get(n)),
+              cnt = cnt_.load(std::memory_order_relaxed);
+      do {
+        if (cnt > MAX - add)
+          return t_errn{EOVERFLOW}; // count must not wrap
+      } while (!cnt_.compare_exchange_weak(cnt, cnt + add,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed));
+      if (waiters_.load(std::memory_order_seq_cst))
+        return wake_(n);
+      return t_errn{0};
+    }
+    return t_errn{-1};
+  }
+
+  inline
+  t_errn t_semaphore::post() noexcept {
+    return post(t_n{1});
+  }
+
+  inline
+  t_void t_semaphore::post(t_err err) noexcept {
+    post(err, t_n{1});
+  }
+
+  inline
+  t_errn t_semaphore::wait() noexcept {
+    return wait_(nullptr);
+  }
+
+  inline
+  t_void t_semaphore::wait(t_err err) noexcept {
+    wait_(err, nullptr);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_barrier::operator t_validity() const noexcept {
+    return parties_ ? VALID : INVALID;
+  }
+
+  inline
+  t_n t_barrier::get_parties() const noexcept {
+    return t_n{parties_};
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_latch::operator t_validity() const noexcept {
+    return valid_;
+  }
+
+  inline
+  t_bool t_latch::try_wait() const noexcept {
+    return cnt_.load(std::memory_order_acquire) == 0;
+  }
+
+  inline
+  t_void t_latch::count_down() noexcept {
+    count_down(t_n{1});
+  }
+
+  inline
+  t_errn t_latch::wait() noexcept {
+    return wait_(nullptr);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, t_n_ N>
+  inline
+  t_mpmc_queue<T, N>::t_mpmc_queue() noexcept {
+    for (t_n_ i = 0; i < N; ++i)
+      cells_[i].seq_.store(i, std::memory_order_relaxed);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_n t_mpmc_queue<T, N>::get_capacity() const noexcept {
+    return t_n{N};
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_mpmc_queue<T, N>::is_empty() const noexcept {
+    return enqueue_.load(std::memory_order_relaxed) ==
+           dequeue_.load(std::memory_order_relaxed);
+  }
+
+  template<typename T, t_n_ N>
+  template<typename V>
+  inline
+  t_bool t_mpmc_queue<T, N>::try_push_(V&& value) noexcept {
+    t_ix_ pos = enqueue_.load(std::memory_order_relaxed);
+    for (;;) {
+      t_cell_& cell = cells_[pos & (N - 1)];
+      t_diff_  diff = static_cast<t_diff_>(
+                        cell.seq_.load(std::memory_order_acquire) - pos);
+      if (diff == 0) {
+        if (enqueue_.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed)) {
+          cell.value_ = std::forward<V>(value);
+          cell.seq_.store(pos + 1, std::memory_order_release);
+          not_empty_.notify_one_after_rmw();
+          return true;
+        }
+      } else if (diff < 0)
+        return false;
+      else
+        pos = enqueue_.load(std::memory_order_relaxed);
+    }
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_mpmc_queue<T, N>::try_push(R_value value) noexcept {
+    return try_push_(value);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_mpmc_queue<T, N>::try_push(x_value value) noexcept {
+    return try_push_(std::move(value));
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_mpmc_queue<T, N>::try_pop(r_value value) noexcept {
+    t_ix_ pos = dequeue_.load(std::memory_order_relaxed);
+    for (;;) {
+      t_cell_& cell = cells_[pos & (N - 1)];
+      t_diff_  diff = static_cast<t_diff_>(
+                        cell.seq_.load(std::memory_order_acquire) - (pos + 1));
+      if (diff == 0) {
+        if (dequeue_.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed)) {
+          value = std::move(cell.value_);
+          cell.seq_.store(pos + N, std::memory_order_release);
+          not_full_.notify_one_after_rmw();
+          return true;
+        }
+      } else if (diff < 0)
+        return false;
+      else
+        pos = dequeue_.load(std::memory_order_relaxed);
+    }
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_mpmc_queue<T, N>::can_push_() const noexcept {
+    return enqueue_.load(std::memory_order_seq_cst) -
+           dequeue_.load(std::memory_order_seq_cst) < N;
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_mpmc_queue<T, N>::can_pop_() const noexcept {
+    return enqueue_.load(std::memory_order_seq_cst) !=
+           dequeue_.load(std::memory_order_seq_cst);
+  }
+
+  template<typename T, t_n_ N>
+  template<typename F, typename G>
+  inline
+  t_errn t_mpmc_queue<T, N>::block_(t_event_count& event, F&& attempt,
+                                    G&& ready,
+                                    const t_deadline* deadline) noexcept {
+    for (t_n_ spin = 0, max = get_spin_max_(SPIN_MAX_); spin < max;
+         ++spin) {
+      if (attempt())
+        return t_errn{0};
+      relax_cpu();
+    }
+    for (;;) {
+      auto key = event.prepare_wait();
+      if (attempt()) {
+        event.cancel_wait();
+        return t_errn{0};
+      }
+      if (ready()) {
+        event.cancel_wait();
+        call_sched_yield();
+        continue;
+      }
+      auto errn = deadline ? event.wait_until(key, *deadline)
+                           : event.wait(key);
+      if (errn != VALID)
+        return errn;
+    }
+  }
+
+  template<typename T, t_n_ N>
+  template<typename F, typename G>
+  inline
+  t_void t_mpmc_queue<T, N>::block_(t_err err, t_event_count& event,
+                                    F&& attempt, G&& ready,
+                                    const t_deadline* deadline) noexcept {
+    ERR_GUARD(err) {
+      for (t_n_ spin = 0, max = get_spin_max_(SPIN_MAX_); spin < max;
+           ++spin) {
+        if (attempt())
+          return;
+        relax_cpu();
+      }
+      do {
+        auto key = event.prepare_wait();
+        if (attempt()) {
+          event.cancel_wait();
+          return;
+        }
+        if (ready()) {
+          event.cancel_wait();
+          call_sched_yield();
+          continue;
+        }
+        if (deadline)
+          event.wait_until(err, key, *deadline);
+        else
+          event.wait(err, key);
+      } while (!err);
+    }
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_errn t_mpmc_queue<T, N>::push(R_value value) noexcept {
+    return block_(not_full_, [&]{ return try_push_(value); },
+                  [this]{ return can_push_(); }, nullptr);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_void t_mpmc_queue<T, N>::push(t_err err, R_value value) noexcept {
+    block_(err, not_full_, [&]{ return try_push_(value); },
+           [this]{ return can_push_(); }, nullptr);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_errn t_mpmc_queue<T, N>::push(x_value value) noexcept {
+    return block_(not_full_, [&]{ return try_push_(std::move(value)); },
+                  [this]{ return can_push_(); }, nullptr);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_void t_mpmc_queue<T, N>::push(t_err err, x_value value) noexcept {
+    block_(err, not_full_, [&]{ return try_push_(std::move(value)); },
+           [this]{ return can_push_(); }, nullptr);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_errn t_mpmc_queue<T, N>::push(R_value value, t_time time) noexcept {
+    t_deadline deadline{time};
+    return block_(not_full_, [&]{ return try_push_(value); },
+                  [this]{ return can_push_(); }, &deadline);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_void t_mpmc_queue<T, N>::push(t_err err, R_value value,
+                                  t_time time) noexcept {
+    ERR_GUARD(err) {
+      t_deadline deadline{err, time};
+      block_(err, not_full_, [&]{ return try_push_(value); },
+             [this]{ return can_push_(); }, &deadline);
+    }
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_errn t_mpmc_queue<T, N>::pop(r_value value) noexcept {
+    return block_(not_empty_, [&]{ return try_pop(value); },
+                  [this]{ return can_pop_(); }, nullptr);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_void t_mpmc_queue<T, N>::pop(t_err err, r_value value) noexcept {
+    block_(err, not_empty_, [&]{ return try_pop(value); },
+           [this]{ return can_pop_(); }, nullptr);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_errn t_mpmc_queue<T, N>::pop(r_value value, t_time time) noexcept {
+    t_deadline deadline{time};
+    return block_(not_empty_, [&]{ return try_pop(value); },
+                  [this]{ return can_pop_(); }, &deadline);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_void t_mpmc_queue<T, N>::pop(t_err err, r_value value,
+                                 t_time time) noexcept {
+    ERR_GUARD(err) {
+      t_deadline deadline{err, time};
+      block_(err, not_empty_, [&]{ return try_pop(value); },
+             [this]{ return can_pop_(); }, &deadline);
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T>
+  inline
+  t_void t_qsbr::retire(T* ptr) noexcept {
+    retire(ptr, [](t_qsbr_node* node) { delete static_cast<T*>(node); });
+  }
+
+  inline
+  t_qsbr_reader::operator t_validity() const noexcept {
+    return slot_ ? VALID : INVALID;
+  }
+
+  inline
+  t_void t_qsbr_reader::quiescent() noexcept {
+    if (slot_)
+      slot_->epoch.store(qsbr_.epoch_.load(std::memory_order_acquire),
+                         std::memory_order_release);
+  }
+
+  inline
+  t_void t_qsbr_reader::offline() noexcept {
+    if (slot_)
+      slot_->epoch.store(0, std::memory_order_release);
+  }
+
+  inline
+  t_void t_qsbr_reader::online() noexcept {
+    if (slot_) {
+      slot_->epoch.store(qsbr_.epoch_.load(std::memory_order_acquire),
+                         std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T>
+  inline
+  t_qsbr_ptr<T>::t_qsbr_ptr(T* ptr) noexcept : ptr_{ptr} {
+  }
+
+  template<typename T>
+  inline
+  T* t_qsbr_ptr<T>::get() const noexcept {
+    return ptr_.load(std::memory_order_acquire);
+  }
+
+  template<typename T>
+  inline
+  T* t_qsbr_ptr<T>::publish(T* ptr) noexcept {
+    return ptr_.exchange(ptr, std::memory_order_acq_rel);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T>
+  inline
+  t_seqlock<T>::t_seqlock() noexcept : t_seqlock(T{}) {
+  }
+
+  template<typename T>
+  inline
+  t_seqlock<T>::t_seqlock(R_value value) noexcept {
+    t_word_ words[WORDS_] = {};
+    std::memcpy(words, &value, sizeof(T));
+    for (t_n_ ix = 0; ix < WORDS_; ++ix)
+      data_[ix].store(words[ix], std::memory_order_relaxed);
+  }
+
+  template<typename T>
+  inline
+  t_void t_seqlock<T>::store(R_value value) noexcept {
+    t_word_ words[WORDS_] = {};
+    std::memcpy(words, &value, sizeof(T));
+
+    t_seq_ seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (t_n_ ix = 0; ix < WORDS_; ++ix)
+      data_[ix].store(words[ix], std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  template<typename T>
+  inline
+  t_bool t_seqlock<T>::try_load(r_value value) const noexcept {
+    t_seq_ seq = seq_.load(std::memory_order_acquire);
+    if (seq & 1)
+      return false;
+    t_word_ words[WORDS_];
+    for (t_n_ ix = 0; ix < WORDS_; ++ix)
+      words[ix] = data_[ix].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq_.load(std::memory_order_relaxed) != seq)
+      return false;
+    std::memcpy(&value, words, sizeof(T));
+    return true;
+  }
+
+  template<typename T>
+  inline
+  typename t_seqlock<T>::t_value t_seqlock<T>::load() const noexcept {
+    t_value value;
+    while (!try_load(value))
+      relax_cpu();
+    return value;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, t_n_ N>
+  inline
+  t_multi_seqlock<T, N>::t_multi_seqlock() noexcept {
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_multi_seqlock<T, N>::t_multi_seqlock(R_value value) noexcept {
+    slots_[0].store(value);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_void t_multi_seqlock<T, N>::store(R_value value) noexcept {
+    auto next = current_.load(std::memory_order_relaxed) + 1;
+    slots_[next % N].store(value);
+    current_.store(next, std::memory_order_release);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  t_bool t_multi_seqlock<T, N>::try_load(r_value value) const noexcept {
+    return slots_[current_.load(std::memory_order_acquire) % N]
+             .try_load(value);
+  }
+
+  template<typename T, t_n_ N>
+  inline
+  typename t_multi_seqlock<T, N>::t_value
+      t_multi_seqlock<T, N>::load() const noexcept {
+    t_value value;
+    while (!try_load(value))
+      relax_cpu();
+    return value;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(__x86_64__)
+  inline
+  t_fiber_scheduler::operator t_validity() const noexcept {
+    return valid_;
+  }
+
+  inline
+  t_n t_fiber_scheduler::get_fibers() const noexcept {
+    return t_n{live_};
+  }
+
+  inline
+  t_errn t_fiber_scheduler::wait_readable(t_fd fd) noexcept {
+    return wait_(fd, EPOLLIN);
+  }
+
+  inline
+  t_errn t_fiber_scheduler::wait_writable(t_fd fd) noexcept {
+    return wait_(fd, EPOLLOUT);
+  }
+
+  template<typename F, typename>
+  inline
+  t_errn t_fiber_scheduler::spawn(F&& func) noexcept {
+    using t_func = typename std::decay<F>::type;
+    p_fiber_ fiber = create_(sizeof(t_func), alignof(t_func));
+    if (!fiber)
+      return t_errn{-1};
+    new (fiber->store) t_func(std::forward<F>(func));
+    fiber->run = [](p_void store) {
+      (*static_cast<t_func*>(store))();
+    };
+    fiber->destroy = [](p_void store) {
+      static_cast<t_func*>(store)->~t_func();
+    };
+    start_(fiber);
+    return t_errn{0};
+  }
+
+  template<typename F, typename>
+  inline
+  t_void t_fiber_scheduler::spawn(t_err err, F&& func) noexcept {
+    ERR_GUARD(err) {
+      if (spawn(std::forward<F>(func)) == INVALID)
+        err = err::E_XXX;
+    }
+  }
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 }
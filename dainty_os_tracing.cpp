@@ -0,0 +1,315 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <new>
+#include "dainty_os_tracing.h"
+
+namespace dainty
+{
+namespace os
+{
+namespace tracing
+{
+  using named::t_int64;
+  using named::t_ticks;
+  using named::get;
+  using threading::t_spsc_ring;
+
+  struct t_tracer::t_buffer_ {
+    std::atomic<t_bool> used{false};   // claimed by a thread
+    std::atomic<t_bool> ready{false};  // tid and name are written
+    std::atomic<t_bool> closed{false}; // the thread let go of it
+    t_pid               tid       = 0;
+    char                name[16]  = {};
+    t_bool              announced = false;
+    t_spsc_ring<t_trace_event, EVENTS_MAX> ring;
+  };
+
+  struct t_tracer::t_shared_ {
+    std::atomic<named::t_uint32> refs{1};
+    t_buffer_                    buffers[THREADS_MAX];
+  };
+
+  // the slots a thread holds, released when it exits
+  struct t_tracer::t_cache_ {
+    struct t_entry_ {
+      t_shared_* shared = nullptr;
+      t_buffer_* buffer = nullptr;
+    };
+
+    t_entry_ entries[CACHE_MAX];
+    t_n_     next = 0;
+
+    static t_void release_(t_entry_& entry) noexcept {
+      if (entry.shared) {
+        entry.buffer->closed.store(true, std::memory_order_release);
+        unref_(entry.shared);
+        entry = t_entry_{};
+      }
+    }
+
+    ~t_cache_() {
+      for (auto& entry : entries)
+        release_(entry);
+    }
+  };
+
+  thread_local t_tracer::t_cache_ t_tracer::cache_;
+
+  namespace
+  {
+    t_int64 to_nsec_(t_stamp stamp) noexcept {
+#if (defined(__x86_64__))
+      return get(clock::tsc_to_monotonic(t_ticks(stamp)).to<named::t_nsec>());
+#else
+      return static_cast<t_int64>(stamp);
+#endif
+    }
+
+    t_n_ escape_(char* out, t_n_ max, const char* name) noexcept {
+      t_n_ len = 0;
+      for (; *name && len + 2 < max; ++name) {
+        if (*name == '"' || *name == '\\')
+          out[len++] = '\\';
+        out[len++] = static_cast<unsigned char>(*name) < 0x20 ? '?' : *name;
+      }
+      out[len] = '\0';
+      return len;
+    }
+
+    constexpr t_n_ OUT_MAX_  = 16384;
+    constexpr t_n_ LINE_MAX_ = 256;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_tracer::t_shared_* t_tracer::create_() noexcept {
+    auto verify = call_mmap(t_n{sizeof(t_shared_)}, PROT_READ | PROT_WRITE, 0);
+    if (verify == VALID)
+      return new (verify.value) t_shared_;
+    return nullptr;
+  }
+
+  t_void t_tracer::unref_(t_shared_* shared) noexcept {
+    if (shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      shared->~t_shared_();
+      call_munmap(shared, t_n{sizeof(t_shared_)});
+    }
+  }
+
+  t_tracer::t_tracer() noexcept : shared_{create_()} {
+  }
+
+  t_tracer::t_tracer(t_err err) noexcept {
+    ERR_GUARD(err) {
+      shared_ = create_();
+      if (!shared_)
+        err = err::E_INIT_FAIL;
+    }
+  }
+
+  t_tracer::~t_tracer() {
+    stop();
+    close();
+    if (shared_)
+      unref_(shared_);
+  }
+
+  t_tracer::t_buffer_* t_tracer::claim_() noexcept {
+    for (auto& entry : cache_.entries)
+      if (entry.shared == shared_)
+        return entry.buffer;
+
+    // nothing is cached when all slots are taken, the next record retries
+    for (auto& buffer : shared_->buffers) {
+      t_bool used = false;
+      if (buffer.used.compare_exchange_strong(used, true,
+                                              std::memory_order_acquire)) {
+        buffer.tid = call_gettid();
+        call_pthread_getname_np(call_pthread_self(), named::p_cstr{buffer.name},
+                                t_n{sizeof(buffer.name)});
+        buffer.closed.store(false, std::memory_order_relaxed);
+        buffer.ready.store(true, std::memory_order_release);
+
+        auto& entry = cache_.entries[cache_.next++ % CACHE_MAX];
+        t_cache_::release_(entry);
+        shared_->refs.fetch_add(1, std::memory_order_relaxed);
+        entry.shared = shared_;
+        entry.buffer = &buffer;
+        return &buffer;
+      }
+    }
+    return nullptr;
+  }
+
+  t_void t_tracer::record(P_cstr name, t_stamp begin, t_stamp end) noexcept {
+    if (shared_) {
+      auto buffer = claim_();
+      if (!buffer || !buffer->ring.push(t_trace_event{get(name), begin, end}))
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_errn t_tracer::open(P_cstr path) noexcept {
+    auto scope = lock_.make_locked_scope();
+    if (fd_ != BAD_FD)
+      return t_errn{-1};
+    auto verify = call_open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (verify == VALID) {
+      fd_    = verify.value;
+      first_ = true;
+      call_write(fd_, "[\n", t_n{2});
+    }
+    return verify.errn;
+  }
+
+  t_void t_tracer::open(t_err err, P_cstr path) noexcept {
+    ERR_GUARD(err) {
+      if (open(path) == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_void t_tracer::write_(char* out, t_n_& len, t_n_ need) noexcept {
+    if (len + need > OUT_MAX_) {
+      call_write(fd_, out, t_n{len});
+      len = 0;
+    }
+  }
+
+  t_n_ t_tracer::drain_(t_buffer_& buffer, char* out, t_n_& len) noexcept {
+    auto pid = ::getpid();
+    if (!buffer.announced) {
+      char name[2*sizeof(buffer.name)];
+      escape_(name, sizeof(name), buffer.name);
+      write_(out, len, LINE_MAX_);
+      len += std::snprintf(out + len, LINE_MAX_,
+        "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+        "\"args\":{\"name\":\"%s\"}}", first_ ? "" : ",\n", pid, buffer.tid,
+        name);
+      first_           = false;
+      buffer.announced = true;
+    }
+
+    t_n_ n = 0;
+    t_trace_event events[64];
+    for (t_n_ cnt; (cnt = get(buffer.ring.pop(events, t_n{64}))); n += cnt) {
+      for (t_n_ ix = 0; ix < cnt; ++ix) {
+        auto& event = events[ix];
+        char  name[128];
+        escape_(name, sizeof(name), event.name);
+        auto begin = to_nsec_(event.begin);
+        auto end   = to_nsec_(event.end);
+        write_(out, len, LINE_MAX_);
+        len += std::snprintf(out + len, LINE_MAX_,
+          "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+          "\"ts\":%.3f,\"dur\":%.3f}", first_ ? "" : ",\n", name, pid,
+          buffer.tid, begin / 1000.0, (end - begin) / 1000.0);
+        first_ = false;
+      }
+    }
+    return n;
+  }
+
+  t_n t_tracer::flush() noexcept {
+    t_n_ n = 0;
+    auto scope = lock_.make_locked_scope();
+    if (shared_ && fd_ != BAD_FD) {
+      char out[OUT_MAX_];
+      t_n_ len = 0;
+      for (auto& buffer : shared_->buffers) {
+        if (buffer.ready.load(std::memory_order_acquire)) {
+          t_bool closed = buffer.closed.load(std::memory_order_acquire);
+          n += drain_(buffer, out, len);
+          if (closed) {
+            buffer.announced = false;
+            buffer.closed.store(false, std::memory_order_relaxed);
+            buffer.ready.store(false, std::memory_order_relaxed);
+            buffer.used.store(false, std::memory_order_release);
+          }
+        }
+      }
+      if (len)
+        call_write(fd_, out, t_n{len});
+    }
+    return t_n{n};
+  }
+
+  t_errn t_tracer::close() noexcept {
+    flush();
+    auto scope = lock_.make_locked_scope();
+    if (fd_ == BAD_FD)
+      return t_errn{-1};
+    call_write(fd_, "\n]\n", t_n{3});
+    return call_close(fd_);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_errn t_tracer::start(P_cstr path, t_time period) noexcept {
+    if (running_.load(std::memory_order_relaxed))
+      return t_errn{-1};
+    auto errn = open(path);
+    if (errn == VALID) {
+      running_.store(true, std::memory_order_relaxed);
+      errn = flusher_.create([this, period]() {
+        auto spec = clock::to_(period);
+        while (running_.load(std::memory_order_relaxed)) {
+          call_clock_nanosleep(CLOCK_MONOTONIC, 0, spec);
+          flush();
+        }
+      });
+      if (errn == INVALID) {
+        running_.store(false, std::memory_order_relaxed);
+        close();
+      }
+    }
+    return errn;
+  }
+
+  t_void t_tracer::start(t_err err, P_cstr path, t_time period) noexcept {
+    ERR_GUARD(err) {
+      if (start(path, period) == INVALID)
+        err = err::E_XXX;
+    }
+  }
+
+  t_void t_tracer::stop() noexcept {
+    if (running_.exchange(false, std::memory_order_relaxed)) {
+      flusher_.join();
+      close();
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
@@ -0,0 +1,192 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_OS_TRACING_H_
+#define _DAINTY_OS_TRACING_H_
+
+// description
+// os: operating system functionality used by dainty
+//
+//  scoped trace zones. every thread records finished zones with their tsc
+//  begin and end into its own spsc ring. a flusher drains the rings into a
+//  chrome trace json file that chrome://tracing and perfetto load. zones
+//  nest by time per thread, so the viewer shows the hierarchy.
+
+#include <atomic>
+#include "dainty_named.h"
+#include "dainty_oops.h"
+#include "dainty_os_call.h"
+#include "dainty_os_clock.h"
+#include "dainty_os_threading.h"
+
+namespace dainty
+{
+namespace os
+{
+namespace tracing
+{
+  using named::t_void;
+  using named::t_bool;
+  using named::t_validity;
+  using named::t_n_;
+  using named::t_n;
+  using named::t_fd;
+  using named::P_cstr;
+  using named::VALID;
+  using named::INVALID;
+  using named::BAD_FD;
+  using err::t_err;
+  using clock::t_time;
+  using threading::t_thread;
+  using threading::t_mutex_lock;
+
+  // tsc on x86_64, CLOCK_MONOTONIC nanoseconds elsewhere
+  using t_stamp = named::t_uint64;
+
+  t_stamp get_stamp() noexcept;
+
+  struct t_trace_event {
+    const char* name; // must outlive the flush, normally a literal
+    t_stamp     begin;
+    t_stamp     end;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // the rings live in one mapping of THREADS_MAX slots. a thread claims a
+  // slot on its first record and gives it back when it exits, once the
+  // flusher has drained it. every claimed slot holds a reference on the
+  // mapping, so threads may outlive the tracer.
+  class t_tracer {
+  public:
+    constexpr static t_n_ THREADS_MAX = 64;
+    constexpr static t_n_ EVENTS_MAX  = 8192;
+    constexpr static t_n_ CACHE_MAX   = 4; // tracers a thread records to
+
+     t_tracer()      noexcept;
+     t_tracer(t_err) noexcept;
+    ~t_tracer();
+
+    t_tracer(const t_tracer&)            = delete;
+    t_tracer(t_tracer&&)                 = delete;
+    t_tracer& operator=(const t_tracer&) = delete;
+    t_tracer& operator=(t_tracer&&)      = delete;
+
+    operator t_validity() const noexcept;
+
+    // an event that does not fit in the ring is dropped and counted
+    t_void record(P_cstr name, t_stamp begin, t_stamp end) noexcept;
+
+    named::t_uint64 get_dropped() const noexcept;
+
+    // flush() appends the events of all rings to the open file
+    t_errn open(       P_cstr path) noexcept;
+    t_void open(t_err, P_cstr path) noexcept;
+    t_n    flush() noexcept;
+    t_errn close() noexcept;
+
+    // open the file and flush it every period from a background thread.
+    // stop() flushes the rest and closes the file.
+    t_errn start(       P_cstr path, t_time period) noexcept;
+    t_void start(t_err, P_cstr path, t_time period) noexcept;
+    t_void stop() noexcept;
+
+  private:
+    struct t_buffer_;
+    struct t_shared_;
+    struct t_cache_;
+
+    static thread_local t_cache_ cache_;
+
+    static t_shared_* create_() noexcept;
+    static t_void     unref_(t_shared_*) noexcept;
+
+    t_buffer_* claim_() noexcept;
+    t_n_       drain_(t_buffer_&, char*, t_n_&) noexcept;
+    t_void     write_(char*, t_n_&, t_n_ need) noexcept;
+
+    t_shared_*                   shared_  = nullptr;
+    std::atomic<named::t_uint64> dropped_{0};
+    t_mutex_lock                 lock_;
+    t_fd                         fd_      = BAD_FD;
+    t_bool                       first_   = true;
+    std::atomic<t_bool>          running_{false};
+    t_thread                     flusher_;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  class t_trace_zone {
+  public:
+    t_trace_zone(t_tracer&, P_cstr name) noexcept;
+    ~t_trace_zone();
+
+    t_trace_zone(const t_trace_zone&)            = delete;
+    t_trace_zone& operator=(const t_trace_zone&) = delete;
+
+  private:
+    t_tracer& tracer_;
+    P_cstr    name_;
+    t_stamp   begin_;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_stamp get_stamp() noexcept {
+#if (defined(__x86_64__))
+    return get(clock::get_ticks());
+#else
+    return static_cast<t_stamp>(get(clock::monotonic_now().to<named::t_nsec>()));
+#endif
+  }
+
+  inline
+  t_tracer::operator t_validity() const noexcept {
+    return shared_ ? VALID : INVALID;
+  }
+
+  inline
+  named::t_uint64 t_tracer::get_dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  inline
+  t_trace_zone::t_trace_zone(t_tracer& tracer, P_cstr name) noexcept
+    : tracer_(tracer), name_(name), begin_(get_stamp()) {
+  }
+
+  inline
+  t_trace_zone::~t_trace_zone() {
+    tracer_.record(name_, begin_, get_stamp());
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif